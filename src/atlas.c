@@ -0,0 +1,94 @@
+#include "atlas.h"
+
+#include "log.h"
+
+#include <SDL_pixels.h>
+#include <SDL_surface.h>
+
+// Keeps neighbouring sprites from bleeding into each other when sampled
+#define ATLAS_PADDING 1
+#define ATLAS_MAX_SIZE 2048
+
+static int32_t next_power_of_two(int32_t value) {
+    int32_t result = 1;
+    while (result < value) {
+        result *= 2;
+    }
+    return result;
+}
+
+SDL_Surface* atlas_build(AtlasSprite sprites[], int32_t num_sprites) {
+    if (num_sprites > MAX_ATLAS_SPRITES) {
+        LOG_ERROR("Too many atlas sprites: %i\n", num_sprites);
+        return NULL;
+    }
+
+    // Tallest sprites first gives the tightest shelves
+    int32_t order[MAX_ATLAS_SPRITES] = {0};
+    int32_t width = 0;
+    for (int32_t i = 0; i < num_sprites; i++) {
+        int32_t j = i;
+        while (j > 0 &&
+               sprites[order[j - 1]].surface->h < sprites[i].surface->h) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+
+        int32_t const padded_width = sprites[i].surface->w + 2 * ATLAS_PADDING;
+        if (padded_width > width) {
+            width = padded_width;
+        }
+    }
+    width = next_power_of_two(width);
+
+    int32_t shelf_x = 0;
+    int32_t shelf_y = 0;
+    int32_t shelf_height = 0;
+    for (int32_t i = 0; i < num_sprites; i++) {
+        AtlasSprite* sprite = &sprites[order[i]];
+        int32_t const w = sprite->surface->w + 2 * ATLAS_PADDING;
+        int32_t const h = sprite->surface->h + 2 * ATLAS_PADDING;
+        if (shelf_x + w > width) {
+            shelf_x = 0;
+            shelf_y += shelf_height;
+            shelf_height = 0;
+        }
+
+        sprite->rect = (SDL_Rect){.x = shelf_x + ATLAS_PADDING,
+                                  .y = shelf_y + ATLAS_PADDING,
+                                  .w = sprite->surface->w,
+                                  .h = sprite->surface->h};
+        shelf_x += w;
+        if (h > shelf_height) {
+            shelf_height = h;
+        }
+    }
+    int32_t const height = next_power_of_two(shelf_y + shelf_height);
+
+    if (width > ATLAS_MAX_SIZE || height > ATLAS_MAX_SIZE) {
+        LOG_ERROR("Atlas of %ix%i is too large\n", width, height);
+        return NULL;
+    }
+    LOG_INFO("Packed %i sprites into a %ix%i atlas\n", num_sprites, width,
+             height);
+
+    SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32,
+                                                        SDL_PIXELFORMAT_RGBA32);
+    if (atlas == NULL) {
+        return NULL;
+    }
+    SDL_FillRect(atlas, NULL, SDL_MapRGBA(atlas->format, 0, 0, 0, 0));
+
+    for (int32_t i = 0; i < num_sprites; i++) {
+        // Copy the pixels as they are, alpha included
+        SDL_SetSurfaceBlendMode(sprites[i].surface, SDL_BLENDMODE_NONE);
+        SDL_Rect dst = sprites[i].rect;
+        if (SDL_BlitSurface(sprites[i].surface, NULL, atlas, &dst) != 0) {
+            SDL_FreeSurface(atlas);
+            return NULL;
+        }
+    }
+
+    return atlas;
+}
@@ -0,0 +1,21 @@
+#ifndef C_TRIS_ATLAS_H_
+#define C_TRIS_ATLAS_H_
+
+#include <SDL_rect.h>
+#include <SDL_surface.h>
+#include <stdint.h>
+
+#define MAX_ATLAS_SPRITES 16
+
+typedef struct {
+    SDL_Surface* surface;
+    // Filled in by atlas_build
+    SDL_Rect rect;
+} AtlasSprite;
+
+// Packs the sprites into shelves of one RGBA surface and stores where each
+// one ended up in its rect. Returns NULL on failure, the surface is owned by
+// the caller.
+SDL_Surface* atlas_build(AtlasSprite sprites[], int32_t num_sprites);
+
+#endif
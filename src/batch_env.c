@@ -0,0 +1,381 @@
+#include "batch_env.h"
+
+#include "game.h"
+#include "jobs.h"
+#include "log.h"
+#include "vec2.h"
+
+#include <SDL_stdinc.h>
+#include <SDL_timer.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// Bricks reach at most two rows above and below their origin, mask row k
+// covers origin row + k - 2.
+#define BRICK_MASK_ROWS 5
+#define FULL_ROW ((uint16_t)((1u << GAME_TILES_WIDE) - 1))
+#define PADDING_ROW ((uint16_t)0xffff)
+// Lanes per job, small enough for a block of boards to stay in L1
+#define LANES_PER_BLOCK 512
+
+typedef enum {
+    ELane_Land = 0,
+    ELane_Fits,
+    ELane_Over,
+    ELane_Lines,
+    ELane_Full,
+    ELane_MAX
+} ELane;
+
+typedef struct {
+    uint16_t masks[GAME_TILES_WIDE][BRICK_MASK_ROWS];
+    int32_t min_column;
+    int32_t max_column;
+} BrickTable;
+
+BrickTable g_brick_tables[NUM_BRICK_TYPES][4] = {0};
+
+// Uses the shapes and rotations of the regular game
+static void build_brick_tables(void) {
+    uint32_t rng_state = 1;
+    for (int32_t shape = 0; shape < NUM_BRICK_TYPES; shape++) {
+        Brick brick = create_brick((EBrickShape)shape, &rng_state);
+        for (int32_t rotation = 0; rotation < 4; rotation++) {
+            BrickTable* table = &g_brick_tables[shape][rotation];
+            int32_t min_x = GAME_TILES_WIDE;
+            int32_t max_x = -GAME_TILES_WIDE;
+            for (int32_t i = 0; i < 4; i++) {
+                min_x = brick.tiles[i].x < min_x ? brick.tiles[i].x : min_x;
+                max_x = brick.tiles[i].x > max_x ? brick.tiles[i].x : max_x;
+            }
+            table->min_column = -min_x;
+            table->max_column = GAME_TILES_WIDE - 1 - max_x;
+
+            memset(table->masks, 0, sizeof(table->masks));
+            for (int32_t column = table->min_column;
+                 column <= table->max_column; column++) {
+                for (int32_t i = 0; i < 4; i++) {
+                    int32_t const k = brick.tiles[i].y + 2;
+                    assert(k >= 0 && k < BRICK_MASK_ROWS);
+                    table->masks[column][k] |=
+                        (uint16_t)(1u << (column + brick.tiles[i].x));
+                }
+            }
+
+            for (int32_t i = 0; i < 4; i++) {
+                brick.tiles[i] = ivec2_rotate_cw(brick.tiles[i]);
+            }
+        }
+    }
+}
+
+static uint32_t lane_rand(uint32_t* rng_state) {
+    uint32_t x = *rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *rng_state = x;
+    return x;
+}
+
+int32_t batch_env_init(BatchEnv* env, int32_t num_envs, uint32_t seed) {
+    build_brick_tables();
+
+    size_t const n = (size_t)num_envs;
+    *env = (BatchEnv){.num_envs = num_envs};
+    env->rows = SDL_calloc(n * BATCH_ENV_ROWS, sizeof(uint16_t));
+    env->current_shape = SDL_calloc(n, sizeof(uint8_t));
+    env->next_shape = SDL_calloc(n, sizeof(uint8_t));
+    env->score = SDL_calloc(n, sizeof(int32_t));
+    env->rng_state = SDL_calloc(n, sizeof(uint32_t));
+    env->brick_masks = SDL_calloc(n * BRICK_MASK_ROWS, sizeof(uint16_t));
+    env->lanes = SDL_calloc(n * ELane_MAX, sizeof(uint16_t));
+    if (env->rows == NULL || env->current_shape == NULL ||
+        env->next_shape == NULL || env->score == NULL ||
+        env->rng_state == NULL || env->brick_masks == NULL ||
+        env->lanes == NULL) {
+        batch_env_release(env);
+        return 1;
+    }
+
+    for (int32_t row = GAME_TILES_HIGH + BATCH_ENV_PAD_TOP;
+         row < BATCH_ENV_ROWS; row++) {
+        for (size_t e = 0; e < n; e++) {
+            env->rows[(size_t)row * n + e] = PADDING_ROW;
+        }
+    }
+    for (size_t e = 0; e < n; e++) {
+        env->rng_state[e] = (seed + (uint32_t)e * 0x9e3779b9) | 1;
+        env->current_shape[e] =
+            (uint8_t)(lane_rand(&env->rng_state[e]) % NUM_BRICK_TYPES);
+        env->next_shape[e] =
+            (uint8_t)(lane_rand(&env->rng_state[e]) % NUM_BRICK_TYPES);
+    }
+
+    return 0;
+}
+
+void batch_env_release(BatchEnv* env) {
+    SDL_free(env->rows);
+    SDL_free(env->current_shape);
+    SDL_free(env->next_shape);
+    SDL_free(env->score);
+    SDL_free(env->rng_state);
+    SDL_free(env->brick_masks);
+    SDL_free(env->lanes);
+    *env = (BatchEnv){0};
+}
+
+static void observe_lanes(BatchEnv const* env, uint16_t* obs, int32_t begin,
+                          int32_t end) {
+    int32_t const n = env->num_envs;
+    for (int32_t y = 0; y < GAME_TILES_HIGH; y++) {
+        uint16_t const* row = &env->rows[(y + BATCH_ENV_PAD_TOP) * n];
+        for (int32_t e = begin; e < end; e++) {
+            obs[e * BATCH_ENV_OBS_SIZE + y] = row[e];
+        }
+    }
+    for (int32_t e = begin; e < end; e++) {
+        obs[e * BATCH_ENV_OBS_SIZE + GAME_TILES_HIGH] = env->current_shape[e];
+        obs[e * BATCH_ENV_OBS_SIZE + GAME_TILES_HIGH + 1] = env->next_shape[e];
+    }
+}
+
+void batch_env_observe(BatchEnv const* env, uint16_t* obs) {
+    observe_lanes(env, obs, 0, env->num_envs);
+}
+
+typedef struct {
+    BatchEnv* env;
+    BatchAction const* actions;
+    uint16_t* obs;
+    int32_t* rewards;
+    uint8_t* dones;
+} StepJob;
+
+// One row of the drop: lanes keep falling while the brick fits at this row.
+// A function of its own so that the restrict qualifiers let the lane loop
+// vectorize without run-time alias checks.
+static void drop_lanes_row(uint16_t const* restrict rows,
+                           uint16_t const* restrict masks,
+                           uint16_t* restrict land, uint16_t* restrict fits,
+                           int32_t n, uint16_t counts, int32_t begin,
+                           int32_t end) {
+    uint16_t const* restrict mask_0 = &masks[0 * n];
+    uint16_t const* restrict mask_1 = &masks[1 * n];
+    uint16_t const* restrict mask_2 = &masks[2 * n];
+    uint16_t const* restrict mask_3 = &masks[3 * n];
+    uint16_t const* restrict mask_4 = &masks[4 * n];
+    for (int32_t e = begin; e < end; e++) {
+        uint16_t const hit =
+            (uint16_t)((rows[0 * n + e] & mask_0[e]) |
+                       (rows[1 * n + e] & mask_1[e]) |
+                       (rows[2 * n + e] & mask_2[e]) |
+                       (rows[3 * n + e] & mask_3[e]) |
+                       (rows[4 * n + e] & mask_4[e]));
+        fits[e] &= hit == 0;
+        land[e] = (uint16_t)(land[e] + (fits[e] & counts));
+    }
+}
+
+// Every loop over e below works on one row of all lanes at a time, without
+// branches, so that it vectorizes. Only the brick table lookup in step 1 is
+// a gather and stays scalar.
+static void step_lanes(void* data, int32_t begin, int32_t end) {
+    StepJob const* job = data;
+    BatchEnv* env = job->env;
+    int32_t const n = env->num_envs;
+    uint16_t* restrict rows = env->rows;
+    uint16_t* restrict masks = env->brick_masks;
+    uint16_t* restrict land = &env->lanes[ELane_Land * n];
+    uint16_t* restrict fits = &env->lanes[ELane_Fits * n];
+    uint16_t* restrict over = &env->lanes[ELane_Over * n];
+    uint16_t* restrict lines = &env->lanes[ELane_Lines * n];
+    uint16_t* restrict full = &env->lanes[ELane_Full * n];
+    int32_t* restrict rewards = job->rewards;
+    int32_t* restrict score = env->score;
+    uint8_t* restrict dones = job->dones;
+
+    // 1. Look up the brick masks for each action
+    for (int32_t e = begin; e < end; e++) {
+        int32_t const rotation = job->actions[e].rotation & 3;
+        BrickTable const* table =
+            &g_brick_tables[env->current_shape[e]][rotation];
+        int32_t column = job->actions[e].column;
+        column = column < table->min_column ? table->min_column : column;
+        column = column > table->max_column ? table->max_column : column;
+        for (int32_t k = 0; k < BRICK_MASK_ROWS; k++) {
+            masks[k * n + e] = table->masks[column][k];
+        }
+    }
+
+    // 2. Drop the bricks, lanes keep falling while the next row fits
+    for (int32_t e = begin; e < end; e++) {
+        land[e] = 0;
+        fits[e] = 1;
+    }
+    static_assert(BRICK_MASK_ROWS == 5, "drop_lanes_row reads five rows");
+    for (int32_t y = 0; y < GAME_TILES_HIGH; y++) {
+        // Row 0 only tells whether the brick fits at all
+        drop_lanes_row(&rows[y * n], masks, land, fits, n, y > 0, begin, end);
+        if (y == 0) {
+            for (int32_t e = begin; e < end; e++) {
+                over[e] = fits[e] == 0;
+            }
+        }
+    }
+
+    // 3. Place the bricks that fit
+    for (int32_t row = 0; row < BATCH_ENV_PAD_TOP + GAME_TILES_HIGH; row++) {
+        for (int32_t e = begin; e < end; e++) {
+            uint16_t placed = 0;
+            for (int32_t k = 0; k < BRICK_MASK_ROWS; k++) {
+                uint16_t const select =
+                    (uint16_t)-(uint16_t)(row == land[e] + k);
+                placed |= masks[k * n + e] & select;
+            }
+            uint16_t const keep = (uint16_t)(over[e] - 1);
+            rows[row * n + e] |= placed & keep;
+        }
+    }
+
+    // 4. Bricks sticking out above the board end the game
+    for (int32_t row = 0; row < BATCH_ENV_PAD_TOP; row++) {
+        for (int32_t e = begin; e < end; e++) {
+            over[e] |= rows[row * n + e] != 0;
+        }
+    }
+
+    // 5. Count full lines and pack them away, one line per pass
+    uint16_t max_lines = 0;
+    for (int32_t e = begin; e < end; e++) {
+        lines[e] = 0;
+    }
+    for (int32_t y = 0; y < GAME_TILES_HIGH; y++) {
+        uint16_t const* row = &rows[(y + BATCH_ENV_PAD_TOP) * n];
+        for (int32_t e = begin; e < end; e++) {
+            lines[e] = (uint16_t)(lines[e] + (row[e] == FULL_ROW));
+        }
+    }
+    for (int32_t e = begin; e < end; e++) {
+        max_lines = lines[e] > max_lines ? lines[e] : max_lines;
+    }
+    for (uint16_t pass = 0; pass < max_lines; pass++) {
+        // Lowest full row, 0 when there is none as that is a padding row
+        for (int32_t e = begin; e < end; e++) {
+            full[e] = 0;
+        }
+        for (int32_t row = BATCH_ENV_PAD_TOP;
+             row < BATCH_ENV_PAD_TOP + GAME_TILES_HIGH; row++) {
+            for (int32_t e = begin; e < end; e++) {
+                bool const is_full = rows[row * n + e] == FULL_ROW;
+                full[e] = is_full ? (uint16_t)row : full[e];
+            }
+        }
+        for (int32_t row = BATCH_ENV_PAD_TOP + GAME_TILES_HIGH - 1;
+             row >= BATCH_ENV_PAD_TOP; row--) {
+            for (int32_t e = begin; e < end; e++) {
+                uint16_t const above =
+                    row > BATCH_ENV_PAD_TOP ? rows[(row - 1) * n + e] : 0;
+                uint16_t* dst = &rows[row * n + e];
+                *dst = row <= full[e] ? above : *dst;
+            }
+        }
+    }
+
+    // 6. Score like game_handle_touchdown and reset finished games
+    for (int32_t e = begin; e < end; e++) {
+        // 1000 * (2^lines - 1) without a variable shift, lines is at most 4
+        int32_t const earned =
+            1000 * ((lines[e] > 0) + 2 * (lines[e] > 1) + 4 * (lines[e] > 2) +
+                    8 * (lines[e] > 3));
+        int32_t const keep = over[e] - 1;
+        rewards[e] = earned & keep;
+        score[e] = (score[e] + earned) & keep;
+        dones[e] = (uint8_t)over[e];
+    }
+    for (int32_t row = 0; row < BATCH_ENV_PAD_TOP + GAME_TILES_HIGH; row++) {
+        for (int32_t e = begin; e < end; e++) {
+            uint16_t const keep = (uint16_t)(over[e] - 1);
+            rows[row * n + e] &= keep;
+        }
+    }
+    uint32_t* restrict rng_state = env->rng_state;
+    uint8_t* restrict current_shape = env->current_shape;
+    uint8_t* restrict next_shape = env->next_shape;
+    for (int32_t e = begin; e < end; e++) {
+        uint8_t const fresh =
+            (uint8_t)(lane_rand(&rng_state[e]) % NUM_BRICK_TYPES);
+        uint8_t const next =
+            (uint8_t)(lane_rand(&rng_state[e]) % NUM_BRICK_TYPES);
+        current_shape[e] = over[e] ? fresh : next_shape[e];
+        next_shape[e] = next;
+    }
+
+    if (job->obs != NULL) {
+        observe_lanes(env, job->obs, begin, end);
+    }
+}
+
+void batch_env_step(BatchEnv* env, BatchAction const* actions, uint16_t* obs,
+                    int32_t* rewards, uint8_t* dones) {
+    StepJob job = {.env = env,
+                   .actions = actions,
+                   .obs = obs,
+                   .rewards = rewards,
+                   .dones = dones};
+    jobs_parallel_for(env->num_envs, LANES_PER_BLOCK, step_lanes, &job);
+}
+
+void batch_env_benchmark(int32_t num_envs, int32_t num_steps) {
+    BatchEnv env = {0};
+    size_t const n = (size_t)num_envs;
+    BatchAction* actions = SDL_calloc(n, sizeof(BatchAction));
+    uint16_t* obs = SDL_calloc(n * BATCH_ENV_OBS_SIZE, sizeof(uint16_t));
+    int32_t* rewards = SDL_calloc(n, sizeof(int32_t));
+    uint8_t* dones = SDL_calloc(n, sizeof(uint8_t));
+    if (actions == NULL || obs == NULL || rewards == NULL || dones == NULL ||
+        batch_env_init(&env, num_envs, 1) != 0) {
+        LOG_ERROR("Could not allocate %i environments\n", num_envs);
+        goto release;
+    }
+
+    uint32_t rng_state = 12345;
+    uint64_t total_steps = 0;
+    uint64_t num_dones = 0;
+    uint64_t elapsed = 0;
+    for (int32_t step = 0; step < num_steps; step++) {
+        for (size_t e = 0; e < n; e++) {
+            uint32_t const r = lane_rand(&rng_state);
+            actions[e].rotation = (int32_t)(r & 3);
+            actions[e].column = (int32_t)((r >> 2) % GAME_TILES_WIDE);
+        }
+
+        uint64_t const start = SDL_GetPerformanceCounter();
+        batch_env_step(&env, actions, obs, rewards, dones);
+        elapsed += SDL_GetPerformanceCounter() - start;
+
+        total_steps += n;
+        for (size_t e = 0; e < n; e++) {
+            num_dones += dones[e];
+        }
+    }
+
+    f64_t const seconds =
+        (f64_t)elapsed / (f64_t)SDL_GetPerformanceFrequency();
+    f64_t const per_second = (f64_t)total_steps / seconds;
+    printf("%i envs x %i steps: %.0f env-steps/s, %.0f per core on %i "
+           "threads, %.2f steps per game\n",
+           num_envs, num_steps, per_second,
+           per_second / (f64_t)jobs_num_threads(), jobs_num_threads(),
+           (f64_t)total_steps / (f64_t)(num_dones > 0 ? num_dones : 1));
+
+release:
+    batch_env_release(&env);
+    SDL_free(actions);
+    SDL_free(obs);
+    SDL_free(rewards);
+    SDL_free(dones);
+}
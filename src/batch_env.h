@@ -0,0 +1,66 @@
+#ifndef C_TRIS_BATCH_ENV_H_
+#define C_TRIS_BATCH_ENV_H_
+
+#include "defs.h"
+
+#include <stdint.h>
+
+/* Batched environments for reinforcement learning:
+Many games are advanced in lock step, one placement per game and call. Boards
+are kept as row bitmasks in structure-of-arrays form, so that collision, line
+clears and scoring run as plain loops across environments that the compiler
+turns into SIMD code (batch_env.c is built with -O3 for this, see
+CMakeLists.txt). Rules match game_handle_touchdown: a brick is dropped
+from the top at the chosen rotation and column, full lines score
+score * 2 + 1000 each, and the game ends when a brick does not fit. Finished
+environments are reset in the same step.
+*/
+
+// Observation of one environment: occupancy of every row (top row first, bit
+// x set when tile x is taken), followed by the current and next brick shape.
+#define BATCH_ENV_OBS_SIZE (GAME_TILES_HIGH + 2)
+
+// Padding around the board so that bricks can be tested against any row
+// without bounds checks.
+#define BATCH_ENV_PAD_TOP 2
+#define BATCH_ENV_PAD_BOTTOM 2
+#define BATCH_ENV_ROWS                                                         \
+    (BATCH_ENV_PAD_TOP + GAME_TILES_HIGH + BATCH_ENV_PAD_BOTTOM)
+
+typedef struct {
+    // Clockwise quarter turns from the spawn orientation, in range [0, 4)
+    int32_t rotation;
+    // Board column of the brick origin, clamped to where the brick fits
+    int32_t column;
+} BatchAction;
+
+typedef struct {
+    int32_t num_envs;
+    // Row y of env e lives at rows[(y + BATCH_ENV_PAD_TOP) * num_envs + e].
+    // Padding rows above the board are empty, the ones below are full.
+    uint16_t* rows;
+    uint8_t* current_shape;
+    uint8_t* next_shape;
+    int32_t* score;
+    uint32_t* rng_state;
+    // Per step scratch, allocated once
+    uint16_t* brick_masks;
+    uint16_t* lanes;
+} BatchEnv;
+
+int32_t batch_env_init(BatchEnv* env, int32_t num_envs, uint32_t seed);
+void batch_env_release(BatchEnv* env);
+
+// Writes num_envs * BATCH_ENV_OBS_SIZE values to obs.
+void batch_env_observe(BatchEnv const* env, uint16_t* obs);
+
+// Applies actions[e] to every env e. Rewards are the score earned, done is
+// set for environments that ended and were reset. obs receives the
+// observations after the step, like batch_env_observe.
+void batch_env_step(BatchEnv* env, BatchAction const* actions, uint16_t* obs,
+                    int32_t* rewards, uint8_t* dones);
+
+// Steps num_envs random games for num_steps and prints the throughput.
+void batch_env_benchmark(int32_t num_envs, int32_t num_steps);
+
+#endif
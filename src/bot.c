@@ -0,0 +1,145 @@
+#include "bot.h"
+
+#include "defs.h"
+#include "game.h"
+#include "transposition.h"
+#include "vec2.h"
+#include "zobrist.h"
+
+#include <float.h>
+#include <stdbool.h>
+#include <string.h>
+
+void bot_init(Bot* bot, TranspositionTable* table) {
+    *bot = (Bot){.planned_brick = -1,
+                 .rotations_left = 0,
+                 .target_x = 0,
+                 .table = table,
+                 .table_stats = {0}};
+}
+
+// Weights from the well known "near perfect" Tetris heuristic.
+static f32_t bot_evaluate(EColor const tiles[], int32_t const heights[]) {
+    int32_t holes = 0;
+    for (int32_t x = 0; x < GAME_TILES_WIDE; x++) {
+        for (int32_t y = GAME_TILES_HIGH - heights[x]; y < GAME_TILES_HIGH;
+             y++) {
+            holes += tiles[y * GAME_TILES_WIDE + x] == EColor_None;
+        }
+    }
+
+    int32_t full_lines = 0;
+    for (int32_t y = 0; y < GAME_TILES_HIGH; y++) {
+        int32_t num_occupied = 0;
+        for (int32_t x = 0; x < GAME_TILES_WIDE; x++) {
+            num_occupied += tiles[y * GAME_TILES_WIDE + x] != EColor_None;
+        }
+        full_lines += num_occupied == GAME_TILES_WIDE;
+    }
+
+    return -0.51f * (f32_t)heights_aggregate(heights) +
+           0.76f * (f32_t)full_lines - 0.36f * (f32_t)holes -
+           0.18f * (f32_t)heights_bumpiness(heights);
+}
+
+// The evaluation only looks at the board, so the board hash alone is the key.
+static f32_t bot_evaluate_cached(Bot* bot, EColor const tiles[],
+                                 int32_t const heights[], uint64_t hash) {
+    if (bot->table == NULL) {
+        return bot_evaluate(tiles, heights);
+    }
+
+    f32_t value = 0.f;
+    uint64_t data = 0;
+    if (tt_probe(bot->table, hash, &data, &bot->table_stats)) {
+        uint32_t const bits = (uint32_t)data;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    value = bot_evaluate(tiles, heights);
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    tt_store(bot->table, hash, bits);
+    return value;
+}
+
+static void bot_plan(Bot* bot, GameState const* game) {
+    bot->planned_brick = game->num_bricks;
+    bot->rotations_left = 0;
+    bot->target_x = game->current_brick.pos.x;
+
+    Brick brick = game->current_brick;
+    f32_t best = -FLT_MAX;
+    for (int32_t rotation = 0; rotation < 4; rotation++) {
+        for (int32_t x = 0; x < GAME_TILES_WIDE; x++) {
+            IVec2 pos = {.x = x, .y = brick.pos.y};
+            if (tiles_check_collision(game->tiles, brick.tiles, pos) !=
+                ECollision_None) {
+                continue;
+            }
+            pos.y += game_drop_distance(game, brick.tiles, pos);
+
+            EColor tiles[NUM_TILES];
+            memcpy(tiles, game->tiles, sizeof(tiles));
+            int32_t heights[GAME_TILES_WIDE];
+            memcpy(heights, game->column_heights, sizeof(heights));
+            uint64_t hash = game->hash;
+            bool fits = true;
+            for (int32_t i = 0; i < 4; i++) {
+                IVec2 const tile = ivec2_add(pos, brick.tiles[i]);
+                if (tile.y < 0) {
+                    fits = false;
+                    break;
+                }
+                int32_t const index = tile.y * GAME_TILES_WIDE + tile.x;
+                tiles[index] = brick.color;
+                hash ^= zobrist_tile(index);
+                if (GAME_TILES_HIGH - tile.y > heights[tile.x]) {
+                    heights[tile.x] = GAME_TILES_HIGH - tile.y;
+                }
+            }
+            if (!fits) {
+                continue;
+            }
+
+            f32_t const value = bot_evaluate_cached(bot, tiles, heights, hash);
+            if (value > best) {
+                best = value;
+                bot->rotations_left = rotation;
+                bot->target_x = x;
+            }
+        }
+
+        for (int32_t i = 0; i < 4; i++) {
+            brick.tiles[i] = ivec2_rotate_cw(brick.tiles[i]);
+        }
+    }
+}
+
+void bot_step(Bot* bot, GameState* game) {
+    if (game->is_over) {
+        return;
+    }
+    if (bot->planned_brick != game->num_bricks) {
+        bot_plan(bot, game);
+    }
+
+    if (bot->rotations_left > 0) {
+        brick_rotate(game, ERotation_CW);
+        bot->rotations_left--;
+        return;
+    }
+
+    int32_t const x = game->current_brick.pos.x;
+    if (bot->target_x != x) {
+        move_sideway(game, bot->target_x > x ? 1 : -1);
+        if (game->current_brick.pos.x != x) {
+            return;
+        }
+        // Blocked on the way, settle for where we are
+        bot->target_x = x;
+    }
+
+    game_handle_down_movement(game, false);
+}
@@ -0,0 +1,24 @@
+#ifndef C_TRIS_BOT_H_
+#define C_TRIS_BOT_H_
+
+#include "game.h"
+#include "transposition.h"
+
+#include <stdint.h>
+
+// Plays a game by picking the best looking placement for every brick and then
+// steering towards it, one move per step.
+typedef struct {
+    int32_t planned_brick;
+    int32_t rotations_left;
+    int32_t target_x;
+    // Optional cache of board evaluations, may be shared between bots
+    TranspositionTable* table;
+    // Probes of table by this bot only
+    TTStats table_stats;
+} Bot;
+
+void bot_init(Bot* bot, TranspositionTable* table);
+void bot_step(Bot* bot, GameState* game);
+
+#endif
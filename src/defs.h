@@ -14,6 +14,7 @@ three equally sized parts.
 #define TILE_SIZE 8
 #define GAME_TILES_WIDE 10
 #define GAME_TILES_HIGH 16
+#define GAME_BOARD_X 80
 
 // Taken from Tic80
 #define UNSCALED_WINDOW_WIDTH 240
@@ -0,0 +1,157 @@
+#include "export.h"
+
+#include "log.h"
+
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// Double buffered: samples go into one chunk while the writer thread saves
+// the other one, so recording only ever waits when the disk falls behind.
+ExportChunk g_export_chunks[2] = {0};
+int32_t g_export_filling = 0;
+// Chunk handed to the writer, -1 tells it to stop
+int32_t g_export_writing = 0;
+
+// Checked without the lock by every thread that records samples
+_Atomic bool g_export_is_open = false;
+FILE* g_export_file = NULL;
+SDL_Thread* g_export_writer = NULL;
+SDL_mutex* g_export_lock = NULL;
+SDL_sem* g_export_ready = NULL;
+SDL_sem* g_export_free = NULL;
+
+static int export_writer_main(void* data) {
+    (void)data;
+    while (1) {
+        SDL_SemWait(g_export_ready);
+        if (g_export_writing < 0) {
+            return 0;
+        }
+
+        ExportChunk const* chunk = &g_export_chunks[g_export_writing];
+        if (fwrite(chunk, sizeof(*chunk), 1, g_export_file) != 1) {
+            LOG_ERROR("%s\n", "Failed to write export chunk");
+        }
+        SDL_SemPost(g_export_free);
+    }
+}
+
+// Expects g_export_lock to be held.
+static void export_hand_off(int32_t chunk) {
+    SDL_SemWait(g_export_free);
+    g_export_writing = chunk;
+    SDL_SemPost(g_export_ready);
+}
+
+// Closes whatever export_open managed to create.
+static void export_release(void) {
+    if (g_export_file != NULL) {
+        fclose(g_export_file);
+    }
+    SDL_DestroyMutex(g_export_lock);
+    SDL_DestroySemaphore(g_export_ready);
+    SDL_DestroySemaphore(g_export_free);
+    g_export_writer = NULL;
+    g_export_file = NULL;
+    g_export_lock = NULL;
+    g_export_ready = NULL;
+    g_export_free = NULL;
+}
+
+int32_t export_open(char const* path) {
+    g_export_file = fopen(path, "wb");
+    if (g_export_file == NULL) {
+        LOG_ERROR("Could not open %s for export\n", path);
+        return 1;
+    }
+
+    ExportFileHeader header = {.version = EXPORT_VERSION,
+                               .header_bytes = sizeof(ExportFileHeader),
+                               .chunk_bytes = sizeof(ExportChunk),
+                               .chunk_samples = EXPORT_CHUNK_SAMPLES,
+                               .board_width = GAME_TILES_WIDE,
+                               .board_height = GAME_TILES_HIGH};
+    memcpy(header.magic, EXPORT_MAGIC, sizeof(header.magic));
+    if (fwrite(&header, sizeof(header), 1, g_export_file) != 1) {
+        export_release();
+        return 1;
+    }
+
+    g_export_lock = SDL_CreateMutex();
+    g_export_ready = SDL_CreateSemaphore(0);
+    // The chunk that is not being filled starts out free
+    g_export_free = SDL_CreateSemaphore(1);
+    if (g_export_lock == NULL || g_export_ready == NULL ||
+        g_export_free == NULL) {
+        LOG_ERROR("Failed to create export locks: %s\n", SDL_GetError());
+        export_release();
+        return 1;
+    }
+    g_export_filling = 0;
+    g_export_writing = 0;
+    g_export_chunks[0].num_samples = 0;
+    g_export_writer = SDL_CreateThread(export_writer_main, "export", NULL);
+    if (g_export_writer == NULL) {
+        LOG_ERROR("Failed to start export writer: %s\n", SDL_GetError());
+        export_release();
+        return 1;
+    }
+
+    atomic_store(&g_export_is_open, true);
+    LOG_INFO("Exporting training data to %s\n", path);
+    return 0;
+}
+
+void export_close(void) {
+    if (!atomic_load(&g_export_is_open)) {
+        return;
+    }
+
+    SDL_LockMutex(g_export_lock);
+    atomic_store(&g_export_is_open, false);
+    if (g_export_chunks[g_export_filling].num_samples > 0) {
+        export_hand_off(g_export_filling);
+    }
+    // Wait for the last chunk, then stop the writer
+    SDL_SemWait(g_export_free);
+    g_export_writing = -1;
+    SDL_SemPost(g_export_ready);
+    SDL_UnlockMutex(g_export_lock);
+
+    SDL_WaitThread(g_export_writer, NULL);
+    export_release();
+}
+
+void export_record(uint16_t const rows[GAME_TILES_HIGH], int32_t piece,
+                   int32_t rotation, int32_t column, int32_t score_delta) {
+    if (!atomic_load_explicit(&g_export_is_open, memory_order_acquire)) {
+        return;
+    }
+
+    SDL_LockMutex(g_export_lock);
+    // Lost a race with export_close
+    if (!atomic_load_explicit(&g_export_is_open, memory_order_relaxed)) {
+        SDL_UnlockMutex(g_export_lock);
+        return;
+    }
+
+    ExportChunk* chunk = &g_export_chunks[g_export_filling];
+    uint32_t const i = chunk->num_samples;
+    memcpy(chunk->rows[i], rows, sizeof(chunk->rows[i]));
+    chunk->piece[i] = (uint8_t)piece;
+    chunk->rotation[i] = (uint8_t)rotation;
+    chunk->column[i] = (int8_t)column;
+    chunk->score_delta[i] = score_delta;
+    chunk->num_samples++;
+
+    if (chunk->num_samples == EXPORT_CHUNK_SAMPLES) {
+        export_hand_off(g_export_filling);
+        g_export_filling ^= 1;
+        g_export_chunks[g_export_filling].num_samples = 0;
+    }
+    SDL_UnlockMutex(g_export_lock);
+}
@@ -0,0 +1,69 @@
+#ifndef C_TRIS_EXPORT_H_
+#define C_TRIS_EXPORT_H_
+
+#include "defs.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Training data export:
+Every brick that touches down becomes one sample of the board it was placed
+on, the brick and where it was placed, and the score it earned. Samples are
+stored column by column in fixed size chunks that follow a file header:
+
+    ExportFileHeader | ExportChunk | ExportChunk | ...
+
+Both structs are written exactly as laid out below (little endian), so a
+reader can mmap the file and index straight into the columns. The last chunk
+may be partially filled, see num_samples. Number of chunks is
+(file size - sizeof(ExportFileHeader)) / sizeof(ExportChunk).
+*/
+
+#define EXPORT_MAGIC "CTRISEX1"
+#define EXPORT_VERSION 1
+#define EXPORT_CHUNK_SAMPLES 4096
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_bytes;
+    uint32_t chunk_bytes;
+    uint32_t chunk_samples;
+    uint32_t board_width;
+    uint32_t board_height;
+    uint8_t reserved[32];
+} ExportFileHeader;
+
+typedef struct {
+    uint32_t num_samples;
+    uint8_t reserved[60];
+    // Board before the brick was placed, top row first. Bit x is set when
+    // tile x of the row is occupied.
+    uint16_t rows[EXPORT_CHUNK_SAMPLES][GAME_TILES_HIGH];
+    // EBrickShape of the placed brick
+    uint8_t piece[EXPORT_CHUNK_SAMPLES];
+    // Clockwise quarter turns from the spawn orientation
+    uint8_t rotation[EXPORT_CHUNK_SAMPLES];
+    // Board column of the brick origin
+    int8_t column[EXPORT_CHUNK_SAMPLES];
+    int32_t score_delta[EXPORT_CHUNK_SAMPLES];
+} ExportChunk;
+
+static_assert(sizeof(ExportFileHeader) == 64, "Header layout changed");
+static_assert(GAME_TILES_WIDE <= 16, "Rows no longer fit in 16 bits");
+static_assert(offsetof(ExportChunk, rows) == 64, "Chunk layout changed");
+static_assert(offsetof(ExportChunk, score_delta) % 4 == 0,
+              "Misaligned score column");
+static_assert(sizeof(ExportChunk) % 64 == 0, "Chunks should stay aligned");
+
+// Starts writing samples to path on a background thread.
+int32_t export_open(char const* path);
+// Writes what is left and closes the file, safe to call when not open.
+void export_close(void);
+
+// Does nothing unless the export is open. May be called from any thread.
+void export_record(uint16_t const rows[GAME_TILES_HIGH], int32_t piece,
+                   int32_t rotation, int32_t column, int32_t score_delta);
+
+#endif
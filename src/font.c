@@ -0,0 +1,120 @@
+#include "font.h"
+
+#include <SDL_pixels.h>
+#include <SDL_surface.h>
+#include <stdbool.h>
+
+// One bit per pixel, row by row starting at the top left corner in bit 14.
+static uint16_t const g_font_glyphs[FONT_NUM_GLYPHS] = {
+    0x0000, // ' '
+    0x0000, // '!'
+    0x0000, // '"'
+    0x0000, // '#'
+    0x0000, // '$'
+    0x52a5, // '%'
+    0x0000, // '&'
+    0x0000, // "'"
+    0x0000, // '('
+    0x0000, // ')'
+    0x0000, // '*'
+    0x0000, // '+'
+    0x0000, // ','
+    0x01c0, // '-'
+    0x0002, // '.'
+    0x12a4, // '/'
+    0x7b6f, // '0'
+    0x2c97, // '1'
+    0x73e7, // '2'
+    0x73cf, // '3'
+    0x5bc9, // '4'
+    0x79cf, // '5'
+    0x79ef, // '6'
+    0x7252, // '7'
+    0x7bef, // '8'
+    0x7bcf, // '9'
+    0x0410, // ':'
+    0x0000, // ';'
+    0x0000, // '<'
+    0x0000, // '='
+    0x0000, // '>'
+    0x0000, // '?'
+    0x0000, // '@'
+    0x2bed, // 'A'
+    0x6bae, // 'B'
+    0x3923, // 'C'
+    0x6b6e, // 'D'
+    0x79a7, // 'E'
+    0x79a4, // 'F'
+    0x396b, // 'G'
+    0x5bed, // 'H'
+    0x7497, // 'I'
+    0x126a, // 'J'
+    0x5bad, // 'K'
+    0x4927, // 'L'
+    0x5fed, // 'M'
+    0x6b6d, // 'N'
+    0x2b6a, // 'O'
+    0x6ba4, // 'P'
+    0x2b73, // 'Q'
+    0x6bad, // 'R'
+    0x388e, // 'S'
+    0x7492, // 'T'
+    0x5b6f, // 'U'
+    0x5b6a, // 'V'
+    0x5bfd, // 'W'
+    0x5aad, // 'X'
+    0x5a92, // 'Y'
+    0x72a7, // 'Z'
+    0x0000, // '['
+    0x0000, // backslash
+    0x0000, // ']'
+    0x0000, // '^'
+    0x0000, // '_'
+};
+
+int32_t font_glyph_index(char c) {
+    if (c >= 'a' && c <= 'z') {
+        c = (char)(c - 'a' + 'A');
+    }
+    int32_t const index = (int32_t)c - FONT_FIRST_CHAR;
+    if (index < 0 || index >= FONT_NUM_GLYPHS) {
+        return 0;
+    }
+    return index;
+}
+
+SDL_Surface* font_create_surface(void) {
+    int32_t const width = FONT_GLYPHS_PER_ROW * FONT_CELL_WIDTH;
+    int32_t const height =
+        (FONT_NUM_GLYPHS / FONT_GLYPHS_PER_ROW) * FONT_CELL_HEIGHT;
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(
+        0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+    if (surface == NULL) {
+        return NULL;
+    }
+
+    Uint32 const white = SDL_MapRGBA(surface->format, 255, 255, 255, 255);
+    Uint32 const clear = SDL_MapRGBA(surface->format, 0, 0, 0, 0);
+
+    SDL_LockSurface(surface);
+    for (int32_t i = 0; i < FONT_NUM_GLYPHS; i++) {
+        int32_t const cell_x = (i % FONT_GLYPHS_PER_ROW) * FONT_CELL_WIDTH;
+        int32_t const cell_y = (i / FONT_GLYPHS_PER_ROW) * FONT_CELL_HEIGHT;
+        for (int32_t y = 0; y < FONT_CELL_HEIGHT; y++) {
+            Uint32* row = (Uint32*)((Uint8*)surface->pixels +
+                                    (cell_y + y) * surface->pitch);
+            for (int32_t x = 0; x < FONT_CELL_WIDTH; x++) {
+                int32_t const bit = (FONT_GLYPH_HEIGHT - 1 - y) *
+                                        FONT_GLYPH_WIDTH +
+                                    (FONT_GLYPH_WIDTH - 1 - x);
+                bool const is_set = x < FONT_GLYPH_WIDTH &&
+                                    y < FONT_GLYPH_HEIGHT &&
+                                    (g_font_glyphs[i] >> bit) & 1;
+                row[cell_x + x] = is_set ? white : clear;
+            }
+        }
+    }
+    SDL_UnlockSurface(surface);
+
+    return surface;
+}
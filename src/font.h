@@ -0,0 +1,24 @@
+#ifndef C_TRIS_FONT_H_
+#define C_TRIS_FONT_H_
+
+#include <SDL_surface.h>
+#include <stdint.h>
+
+// Tiny 3x5 bitmap font covering ' ' to '_', lower case letters are drawn as
+// upper case. Glyphs are laid out in a grid of cells with one pixel of spacing
+// to the right and below each glyph.
+#define FONT_GLYPH_WIDTH 3
+#define FONT_GLYPH_HEIGHT 5
+#define FONT_CELL_WIDTH (FONT_GLYPH_WIDTH + 1)
+#define FONT_CELL_HEIGHT (FONT_GLYPH_HEIGHT + 1)
+#define FONT_FIRST_CHAR ' '
+#define FONT_NUM_GLYPHS 64
+#define FONT_GLYPHS_PER_ROW 16
+
+// Index of the glyph used for c, in range [0, FONT_NUM_GLYPHS).
+int32_t font_glyph_index(char c);
+
+// White glyphs on a transparent background, owned by the caller.
+SDL_Surface* font_create_surface(void);
+
+#endif
@@ -0,0 +1,552 @@
+#include "game.h"
+
+#include "defs.h"
+#include "export.h"
+#include "log.h"
+#include "particles.h"
+#include "render.h"
+#include "sound.h"
+#include "vec2.h"
+#include "zobrist.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+EColor get_color_from_shape(EBrickShape shape) {
+    switch (shape) {
+        case EBrickShape_Straight:
+            return EColor_LtBlue;
+        case EBrickShape_Square:
+            return EColor_Pink;
+        case EBrickShape_T:
+            return EColor_Blue;
+        case EBrickShape_LRight:
+            return EColor_Purple;
+        case EBrickShape_LLeft:
+            return EColor_Orange;
+        case EBrickShape_RSkew:
+            return EColor_Red;
+        case EBrickShape_LSkew:
+            return EColor_Green;
+        default:
+            return EColor_None;
+    }
+}
+
+// Xorshift32, good enough for picking bricks and cheap to keep per game.
+static uint32_t rand_next(uint32_t* rng_state) {
+    uint32_t x = *rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *rng_state = x;
+    return x;
+}
+
+int32_t rand_n(uint32_t* rng_state, int32_t max) {
+    return (int32_t)(rand_next(rng_state) % (uint32_t)max);
+}
+
+ECollision tiles_check_collision(EColor const tiles[],
+                                 IVec2 const brick_tiles[], IVec2 new_pos) {
+    for (int32_t i = 0; i < 4; i++) {
+        int32_t const x = new_pos.x + brick_tiles[i].x;
+        int32_t const y = new_pos.y + brick_tiles[i].y;
+
+        if (y >= GAME_TILES_HIGH) {
+            return ECollision_Bottom;
+        }
+
+        if (x < 0 || x >= GAME_TILES_WIDE) {
+            return ECollision_Side;
+        }
+
+        // Freshly spawned bricks may stick out above the board
+        if (y < 0) {
+            continue;
+        }
+
+        int32_t index = y * GAME_TILES_WIDE + x;
+        if (index >= NUM_TILES) {
+            LOG_ERROR("Received out-of-bounds index %i\n", index);
+            assert(NULL);
+        }
+        if (tiles[index] != EColor_None) {
+            return ECollision_Bottom;
+        }
+    }
+
+    return ECollision_None;
+}
+
+void tiles_column_heights(EColor const tiles[], int32_t heights[]) {
+    for (int32_t x = 0; x < GAME_TILES_WIDE; x++) {
+        heights[x] = 0;
+        for (int32_t y = 0; y < GAME_TILES_HIGH; y++) {
+            if (tiles[y * GAME_TILES_WIDE + x] != EColor_None) {
+                heights[x] = GAME_TILES_HIGH - y;
+                break;
+            }
+        }
+    }
+}
+
+int32_t heights_aggregate(int32_t const heights[]) {
+    int32_t aggregate = 0;
+    for (int32_t x = 0; x < GAME_TILES_WIDE; x++) {
+        aggregate += heights[x];
+    }
+    return aggregate;
+}
+
+int32_t heights_bumpiness(int32_t const heights[]) {
+    int32_t bumpiness = 0;
+    for (int32_t x = 1; x < GAME_TILES_WIDE; x++) {
+        int32_t const diff = heights[x] - heights[x - 1];
+        bumpiness += diff < 0 ? -diff : diff;
+    }
+    return bumpiness;
+}
+
+int32_t game_drop_distance(GameState const* game, IVec2 const brick_tiles[],
+                           IVec2 pos) {
+    int32_t distance = GAME_TILES_HIGH;
+    for (int32_t i = 0; i < 4; i++) {
+        int32_t const x = pos.x + brick_tiles[i].x;
+        int32_t const y = pos.y + brick_tiles[i].y;
+        // Not a valid position, there is nowhere to drop to
+        if (x < 0 || x >= GAME_TILES_WIDE) {
+            return 0;
+        }
+        int32_t const surface = GAME_TILES_HIGH - game->column_heights[x];
+        int32_t const room = surface - 1 - y;
+        distance = room < distance ? room : distance;
+    }
+    if (distance >= 0) {
+        return distance;
+    }
+
+    // Part of the brick is below the surface, probe row by row instead
+    distance = 0;
+    while (tiles_check_collision(game->tiles, brick_tiles,
+                                 (IVec2){pos.x, pos.y + distance + 1}) ==
+           ECollision_None) {
+        distance++;
+    }
+    return distance;
+}
+
+Brick create_brick(EBrickShape shape, uint32_t* rng_state) {
+    Brick brick = {0};
+    brick.color = get_color_from_shape(shape);
+    brick.shape = shape;
+    brick.pos = (IVec2){2 + rand_n(rng_state, GAME_TILES_WIDE - 4), 0};
+
+    switch (shape) {
+        case EBrickShape_Straight: {
+            LOG_INFO("%s\n", "Creating Straight brick");
+            brick.tiles[0] = (IVec2){.x = -1, .y = 0};
+            brick.tiles[1] = (IVec2){.x = 0, .y = 0};
+            brick.tiles[2] = (IVec2){.x = 1, .y = 0};
+            brick.tiles[3] = (IVec2){.x = 2, .y = 0};
+        } break;
+        case EBrickShape_Square: {
+            LOG_INFO("%s\n", "Creating Square brick");
+            brick.tiles[0] = (IVec2){.x = 0, .y = 0};
+            brick.tiles[1] = (IVec2){.x = 1, .y = 0};
+            brick.tiles[2] = (IVec2){.x = 0, .y = 1};
+            brick.tiles[3] = (IVec2){.x = 1, .y = 1};
+        } break;
+        case EBrickShape_T: {
+            LOG_INFO("%s\n", "Creating T brick");
+            brick.tiles[0] = (IVec2){.x = 0, .y = 0};
+            brick.tiles[1] = (IVec2){.x = -1, .y = 0};
+            brick.tiles[2] = (IVec2){.x = 1, .y = 0};
+            brick.tiles[3] = (IVec2){.x = 0, .y = -1};
+        } break;
+        case EBrickShape_LRight: {
+            LOG_INFO("%s\n", "Creating LRight brick");
+            brick.tiles[0] = (IVec2){.x = -1, .y = 0};
+            brick.tiles[1] = (IVec2){.x = 0, .y = 0};
+            brick.tiles[2] = (IVec2){.x = 1, .y = 0};
+            brick.tiles[3] = (IVec2){.x = 1, .y = -1};
+        } break;
+        case EBrickShape_LLeft: {
+            LOG_INFO("%s\n", "Creating LLeft brick");
+            brick.tiles[0] = (IVec2){.x = -1, .y = 0};
+            brick.tiles[1] = (IVec2){.x = 0, .y = 0};
+            brick.tiles[2] = (IVec2){.x = 1, .y = 0};
+            brick.tiles[3] = (IVec2){.x = 1, .y = 1};
+        } break;
+        case EBrickShape_RSkew: {
+            LOG_INFO("%s\n", "Creating RSkew brick");
+            brick.tiles[0] = (IVec2){.x = -1, .y = 1};
+            brick.tiles[1] = (IVec2){.x = 1, .y = 0};
+            brick.tiles[2] = (IVec2){.x = 0, .y = 0};
+            brick.tiles[3] = (IVec2){.x = 0, .y = 1};
+        } break;
+        case EBrickShape_LSkew: {
+            LOG_INFO("%s\n", "Creating LSkew brick");
+            brick.tiles[0] = (IVec2){.x = -1, .y = 0};
+            brick.tiles[1] = (IVec2){.x = 0, .y = 0};
+            brick.tiles[2] = (IVec2){.x = 0, .y = 1};
+            brick.tiles[3] = (IVec2){.x = 1, .y = 1};
+        } break;
+        default: {
+            assert(false);
+        }
+    }
+    return brick;
+}
+
+Brick create_random_brick(uint32_t* rng_state) {
+    EBrickShape const shape = (EBrickShape)rand_n(rng_state, NUM_BRICK_TYPES);
+    assert(shape <= NUM_BRICK_TYPES);
+    return create_brick(shape, rng_state);
+}
+
+void game_init(GameState* game, uint32_t seed) {
+    *game = (GameState){0};
+    // Xorshift gets stuck on zero
+    game->rng_state = seed != 0 ? seed : 0x9e3779b9;
+    game->current_brick = create_random_brick(&game->rng_state);
+    game->next_brick = create_random_brick(&game->rng_state);
+}
+
+void game_set_tile(GameState* game, int32_t index, EColor color) {
+    bool const was_occupied = game->tiles[index] != EColor_None;
+    bool const is_occupied = color != EColor_None;
+    if (was_occupied != is_occupied) {
+        game->hash ^= zobrist_tile(index);
+        game->row_masks[index / GAME_TILES_WIDE] ^=
+            (uint16_t)(1u << (index % GAME_TILES_WIDE));
+    }
+    game->tiles[index] = color;
+}
+
+uint64_t tiles_hash(EColor const tiles[]) {
+    uint64_t hash = 0;
+    for (int32_t i = 0; i < NUM_TILES; i++) {
+        if (tiles[i] != EColor_None) {
+            hash ^= zobrist_tile(i);
+        }
+    }
+    return hash;
+}
+
+IVec2 tile_index_to_pos(int32_t index) {
+    int32_t x = index % GAME_TILES_WIDE;
+    int32_t y = index / GAME_TILES_WIDE;
+    return (IVec2){.x = x, .y = y};
+}
+
+int32_t pos_to_tile_index(IVec2 pos) { return pos.y * GAME_TILES_WIDE + pos.x; }
+
+bool row_is_empty(EColor const* first_index) {
+    for (int32_t x = 0; x < GAME_TILES_WIDE; x++) {
+        EColor const tile = *(first_index + x);
+        if (tile != EColor_None) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int32_t lowest_nonempty_tile_index(EColor const* tiles) {
+    for (int32_t i = 0; i < NUM_TILES; i++) {
+        if (tiles[i] != EColor_None) {
+            return i;
+        }
+    }
+    return NUM_TILES - 1;
+}
+
+static int32_t min(int32_t lhs, int32_t rhs) { return lhs < rhs ? lhs : rhs; }
+static int32_t max(int32_t lhs, int32_t rhs) { return lhs > rhs ? lhs : rhs; }
+
+void spawn_particles(Brick* brick) {
+
+    int32_t max_y = INT32_MIN;
+    for (int32_t i = 0; i < 4; i++) {
+        max_y = max(brick->tiles[i].y, max_y);
+    }
+
+    int32_t min_x = INT32_MAX;
+    int32_t max_x = INT32_MIN;
+    for (int32_t i = 0; i < 4; i++) {
+        if (brick->tiles[i].y == max_y) {
+            min_x = min(min_x, brick->tiles[i].x);
+            max_x = max(max_x, brick->tiles[i].x);
+        }
+    }
+
+    particles_spawn(50, (f32_t)brick->pos.y + (f32_t)max_y + 1.f,
+                    (f32_t)brick->pos.x + (f32_t)min_x,
+                    (f32_t)brick->pos.x + (f32_t)max_x + 1.f);
+}
+
+void game_handle_touchdown(GameState* game, bool with_force) {
+    // 0. Handle force, bots on job workers have no effects and must not
+    // touch the shared particle pool
+    if (with_force && game->has_effects) {
+        spawn_particles(&game->current_brick);
+        sound_touchdown();
+    }
+
+    Brick const placed = game->current_brick;
+    int32_t const score_before = game->score;
+    uint16_t rows_before[GAME_TILES_HIGH];
+    memcpy(rows_before, game->row_masks, sizeof(rows_before));
+
+    // 1. Move brick tiles to game.tiles
+    for (int32_t i = 0; i < 4; i++) {
+        IVec2 const pos =
+            ivec2_add(game->current_brick.tiles[i], game->current_brick.pos);
+        if (pos.y < 0) {
+            // Brick came to rest sticking out of the board
+            game->is_over = true;
+            return;
+        }
+        // brick_rotate and move_sideway never leave a brick off the board
+        assert(pos.x >= 0 && pos.x < GAME_TILES_WIDE);
+        int32_t tile_index = pos_to_tile_index(pos);
+        game_set_tile(game, tile_index, game->current_brick.color);
+
+        int32_t const height = GAME_TILES_HIGH - pos.y;
+        if (height > game->column_heights[pos.x]) {
+            game->column_heights[pos.x] = height;
+        }
+    }
+    game->num_bricks++;
+
+    // 2. Spawn a new (random) brick
+    game->current_brick = game->next_brick;
+    game->next_brick = create_random_brick(&game->rng_state);
+
+    // 3. Rotate next brick
+    int32_t const rotations = rand_n(&game->rng_state, 4);
+    for (int j = 0; j < rotations; j++) {
+        for (int i = 0; i < 4; i++) {
+            game->current_brick.tiles[i] =
+                ivec2_rotate_cw(game->current_brick.tiles[i]);
+        }
+    }
+    game->current_brick.rotation = rotations;
+
+    // 4. Remove full lines
+    int32_t score = 0;
+    int32_t cleared_rows[4] = {0};
+    int32_t num_cleared = 0;
+    for (int32_t y = 0; y < GAME_TILES_HIGH; y++) {
+        int32_t const x_start = y * GAME_TILES_WIDE;
+        int32_t num_occupied = 0;
+        for (int32_t x = 0; x < GAME_TILES_WIDE; x++) {
+            if (game->tiles[x_start + x] == EColor_None) {
+                break;
+            }
+            if (++num_occupied == GAME_TILES_WIDE) {
+                for (int32_t i = 0; i < GAME_TILES_WIDE; i++) {
+                    game_set_tile(game, x_start + i, EColor_None);
+                }
+                score = score * 2 + 1000;
+                game->lines++;
+                if (num_cleared < 4) {
+                    cleared_rows[num_cleared++] = y;
+                }
+            }
+        }
+    }
+    game->score += score;
+
+    if (game->has_effects && num_cleared > 0) {
+        particles_emit_line_clear(cleared_rows, num_cleared);
+    }
+
+    // 5. Pack tiles
+    if (score > 0) {
+        for (int32_t y0 = GAME_TILES_HIGH - 1; y0 > 0; y0--) {
+            int32_t const x_start = y0 * GAME_TILES_WIDE;
+            while (row_is_empty(&game->tiles[x_start]) &&
+                   lowest_nonempty_tile_index(game->tiles) < x_start) {
+                for (int32_t y1 = y0; y1 > 0; y1--) {
+                    int32_t const dst = y1 * GAME_TILES_WIDE;
+                    int32_t const src = (y1 - 1) * GAME_TILES_WIDE;
+                    LOG_INFO("Packing: Moving %i to %i\n", src, dst);
+                    for (int32_t x = 0; x < GAME_TILES_WIDE; x++) {
+                        game_set_tile(game, dst + x, game->tiles[src + x]);
+                    }
+                }
+                // Nothing moves into the top row
+                for (int32_t x = 0; x < GAME_TILES_WIDE; x++) {
+                    game_set_tile(game, x, EColor_None);
+                }
+            }
+        }
+
+        // Every cleared row was at or below the top of each column, so the
+        // stacks shrink by that much. Columns whose top tile was cleared
+        // continue down to the next tile.
+        for (int32_t x = 0; x < GAME_TILES_WIDE; x++) {
+            int32_t height = game->column_heights[x] - num_cleared;
+            while (height > 0 &&
+                   game->tiles[(GAME_TILES_HIGH - height) * GAME_TILES_WIDE +
+                               x] == EColor_None) {
+                height--;
+            }
+            game->column_heights[x] = height;
+        }
+    }
+    assert(game->hash == tiles_hash(game->tiles));
+#ifdef DEBUG
+    int32_t heights[GAME_TILES_WIDE];
+    tiles_column_heights(game->tiles, heights);
+    assert(memcmp(heights, game->column_heights, sizeof(heights)) == 0);
+#endif
+
+    export_record(rows_before, placed.shape, placed.rotation, placed.pos.x,
+                  game->score - score_before);
+
+    // 6. No room left for the new brick
+    if (tiles_check_collision(game->tiles, game->current_brick.tiles,
+                              game->current_brick.pos) != ECollision_None) {
+        game->is_over = true;
+    }
+}
+
+void game_handle_down_movement(GameState* game, bool with_force) {
+    Brick* b = &game->current_brick;
+    EColor* t = game->tiles;
+
+    IVec2 new_pos = b->pos;
+    new_pos.y += 1;
+
+    ECollision const collision = tiles_check_collision(t, b->tiles, new_pos);
+    if (collision == ECollision_None) {
+        b->pos = new_pos;
+    } else if (collision == ECollision_Side) {
+        assert(NULL);
+    } else if (collision == ECollision_Bottom) {
+        game_handle_touchdown(game, with_force);
+    }
+}
+
+void game_handle_hard_drop(GameState* game) {
+    Brick* b = &game->current_brick;
+    b->pos.y += game_drop_distance(game, b->tiles, b->pos);
+    game_handle_touchdown(game, true);
+}
+
+void brick_rotate(GameState* game, ERotation rot) {
+    IVec2 new_tiles[4] = {0};
+    for (int i = 0; i < 4; i++) {
+        IVec2 const tile_pos = game->current_brick.tiles[i];
+        if (rot == ERotation_CW) {
+            new_tiles[i] = ivec2_rotate_cw(tile_pos);
+        } else {
+            new_tiles[i] = ivec2_rotate_ccw(tile_pos);
+        }
+    }
+
+    ECollision const collision =
+        tiles_check_collision(game->tiles, new_tiles, game->current_brick.pos);
+    if (collision == ECollision_Bottom) {
+        return;
+    }
+
+    // Move sideways until we fit, or leave the brick as it was
+    if (collision == ECollision_Side) {
+        int32_t offset[4] = {1, -1, 2, -2};
+        bool fits = false;
+        for (int32_t i = 0; i < 4 && !fits; i++) {
+            IVec2 offseted_pos = game->current_brick.pos;
+            offseted_pos.x += offset[i];
+            if (ECollision_None ==
+                tiles_check_collision(game->tiles, new_tiles, offseted_pos)) {
+                game->current_brick.pos = offseted_pos;
+                fits = true;
+            }
+        }
+        if (!fits) {
+            return;
+        }
+    }
+
+    memcpy(game->current_brick.tiles, new_tiles, 4 * sizeof(IVec2));
+    game->current_brick.rotation =
+        (game->current_brick.rotation + (rot == ERotation_CW ? 1 : 3)) % 4;
+}
+
+void move_sideway(GameState* game, int32_t dy) {
+    IVec2 new_pos = game->current_brick.pos;
+    new_pos.x += dy;
+    if (ECollision_None == tiles_check_collision(game->tiles,
+                                                 game->current_brick.tiles,
+                                                 new_pos)) {
+        game->current_brick.pos = new_pos;
+    }
+}
+
+void draw_brick(Brick const* brick, BoardView const* view) {
+    for (int i = 0; i < 4; i++) {
+        IVec2 pos = ivec2_add(brick->pos, brick->tiles[i]);
+        render_draw_tile(view, pos.x, pos.y, brick->color);
+    }
+}
+
+void draw_ghost_brick(GameState const* game, BoardView const* view) {
+    Brick const* brick = &game->current_brick;
+    IVec2 ghost_pos = brick->pos;
+    ghost_pos.y += game_drop_distance(game, brick->tiles, brick->pos);
+    for (int i = 0; i < 4; i++) {
+        IVec2 pos = ivec2_add(ghost_pos, brick->tiles[i]);
+        render_draw_ghost_tile(view, pos.x, pos.y, brick->color);
+    }
+}
+
+void draw_brick_preview(Brick const* brick, BoardView const* view) {
+    IVec2 preview_pos = {.x = 14, .y = 3};
+    for (int i = 0; i < 4; i++) {
+        IVec2 pos = ivec2_add(preview_pos, brick->tiles[i]);
+        render_draw_tile(view, pos.x, pos.y, brick->color);
+    }
+}
+
+void draw_tiles(EColor const tiles[], BoardView const* view) {
+    for (int i = 0; i < NUM_TILES; i++) {
+        if (tiles[i] == EColor_None) {
+            continue;
+        }
+
+        EColor const color = tiles[i];
+        IVec2 const pos = tile_index_to_pos(i);
+        render_draw_tile(view, pos.x, pos.y, color);
+    }
+}
+
+void game_draw(GameState const* game, BoardView const* view,
+               bool with_preview) {
+    draw_tiles(game->tiles, view);
+    if (with_preview) {
+        draw_ghost_brick(game, view);
+    }
+    draw_brick(&game->current_brick, view);
+    if (with_preview) {
+        draw_brick_preview(&game->next_brick, view);
+    }
+}
+
+void game_draw_hud(GameState const* game, BoardView const* view) {
+    Pixel const white = {.r = 255, .g = 255, .b = 255, .a = 255};
+    f32_t const tile_size = (f32_t)TILE_SIZE * view->scale;
+    f32_t const x = view->x + (f32_t)(GAME_TILES_WIDE + 2) * tile_size;
+    f32_t const y = view->y + 8.f * tile_size;
+
+    char text[32];
+    snprintf(text, sizeof(text), "SCORE %i", game->score);
+    render_draw_text(x, y, view->scale, white, text);
+    snprintf(text, sizeof(text), "LINES %i", game->lines);
+    render_draw_text(x, y + tile_size, view->scale, white, text);
+}
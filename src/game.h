@@ -0,0 +1,104 @@
+#ifndef C_TRIS_GAME_H_
+#define C_TRIS_GAME_H_
+
+#include "defs.h"
+#include "render.h"
+#include "vec2.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define NUM_BRICK_TYPES 7
+typedef enum {
+    EBrickShape_Straight = 0,
+    EBrickShape_Square,
+    EBrickShape_T,
+    EBrickShape_LRight,
+    EBrickShape_LLeft,
+    EBrickShape_RSkew,
+    EBrickShape_LSkew,
+} EBrickShape;
+
+typedef struct {
+    IVec2 pos;
+    IVec2 tiles[4];
+    EColor color;
+    EBrickShape shape;
+    // Clockwise quarter turns from the spawn orientation
+    int32_t rotation;
+} Brick;
+
+#define NUM_TILES (GAME_TILES_WIDE * GAME_TILES_HIGH)
+
+typedef struct {
+    EColor tiles[NUM_TILES];
+    // Occupancy of each row, bit x is set when tile x is taken
+    uint16_t row_masks[GAME_TILES_HIGH];
+    // Height of the stack in each column, 0 when the column is empty. Updated
+    // incrementally by game_handle_touchdown.
+    int32_t column_heights[GAME_TILES_WIDE];
+    Brick current_brick;
+    Brick next_brick;
+    int32_t score;
+    int32_t lines;
+    // Number of bricks that have touched down, lets observers (e.g. bots)
+    // notice that the current brick has been replaced.
+    int32_t num_bricks;
+    // Each game owns its random state so that several games can be advanced
+    // on different threads.
+    uint32_t rng_state;
+    // Zobrist hash of which tiles are occupied, kept up to date by
+    // game_set_tile.
+    uint64_t hash;
+    // Particles and sounds, only for the game that is played on screen
+    bool has_effects;
+    bool is_over;
+} GameState;
+
+typedef enum {
+    ECollision_None = 0,
+    ECollision_Side = 1,
+    ECollision_Bottom = 2,
+} ECollision;
+
+typedef enum {
+    ERotation_CW = 0,
+    ERotation_CCW,
+} ERotation;
+
+void game_init(GameState* game, uint32_t seed);
+
+// Returns int in range [0, n).
+int32_t rand_n(uint32_t* rng_state, int32_t max);
+
+Brick create_brick(EBrickShape shape, uint32_t* rng_state);
+Brick create_random_brick(uint32_t* rng_state);
+
+// All changes to game->tiles go through here to keep game->hash and
+// game->row_masks in sync.
+void game_set_tile(GameState* game, int32_t index, EColor color);
+
+uint64_t tiles_hash(EColor const tiles[]);
+
+ECollision tiles_check_collision(EColor const tiles[],
+                                 IVec2 const brick_tiles[], IVec2 new_pos);
+
+void tiles_column_heights(EColor const tiles[], int32_t heights[]);
+int32_t heights_aggregate(int32_t const heights[]);
+int32_t heights_bumpiness(int32_t const heights[]);
+
+// Rows the brick can fall from pos before it touches down. Looks at the
+// column heights only, unless the brick has been slid in under an overhang.
+int32_t game_drop_distance(GameState const* game, IVec2 const brick_tiles[],
+                           IVec2 pos);
+
+void game_handle_touchdown(GameState* game, bool with_force);
+void game_handle_down_movement(GameState* game, bool with_force);
+void game_handle_hard_drop(GameState* game);
+void brick_rotate(GameState* game, ERotation rot);
+void move_sideway(GameState* game, int32_t dy);
+
+void game_draw(GameState const* game, BoardView const* view, bool with_preview);
+void game_draw_hud(GameState const* game, BoardView const* view);
+
+#endif
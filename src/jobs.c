@@ -0,0 +1,132 @@
+#include "jobs.h"
+
+#include "log.h"
+
+#include <SDL_atomic.h>
+#include <SDL_cpuinfo.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+#include <stdbool.h>
+
+#define MAX_WORKERS 32
+
+typedef struct {
+    JobFunc func;
+    void* data;
+    int32_t count;
+    int32_t chunk_size;
+    SDL_atomic_t next_chunk;
+} Job;
+
+SDL_Thread* g_workers[MAX_WORKERS] = {0};
+int32_t g_num_workers = 0;
+SDL_sem* g_jobs_start = NULL;
+SDL_sem* g_jobs_done = NULL;
+Job g_job = {0};
+bool g_jobs_quit = false;
+
+static void job_run_chunks(Job* job) {
+    int32_t const num_chunks =
+        (job->count + job->chunk_size - 1) / job->chunk_size;
+    while (1) {
+        int32_t const chunk = SDL_AtomicAdd(&job->next_chunk, 1);
+        if (chunk >= num_chunks) {
+            return;
+        }
+        int32_t const begin = chunk * job->chunk_size;
+        int32_t end = begin + job->chunk_size;
+        if (end > job->count) {
+            end = job->count;
+        }
+        job->func(job->data, begin, end);
+    }
+}
+
+static int worker_main(void* data) {
+    (void)data;
+    while (1) {
+        SDL_SemWait(g_jobs_start);
+        if (g_jobs_quit) {
+            return 0;
+        }
+        job_run_chunks(&g_job);
+        SDL_SemPost(g_jobs_done);
+    }
+}
+
+int32_t jobs_init(int32_t num_workers) {
+    if (num_workers < 0) {
+        num_workers = SDL_GetCPUCount() - 1;
+    }
+    if (num_workers > MAX_WORKERS) {
+        num_workers = MAX_WORKERS;
+    }
+
+    g_jobs_start = SDL_CreateSemaphore(0);
+    g_jobs_done = SDL_CreateSemaphore(0);
+    if (g_jobs_start == NULL || g_jobs_done == NULL) {
+        return 1;
+    }
+
+    g_jobs_quit = false;
+    for (int32_t i = 0; i < num_workers; i++) {
+        g_workers[i] = SDL_CreateThread(worker_main, "jobs", NULL);
+        if (g_workers[i] == NULL) {
+            LOG_ERROR("Failed to start worker: %s\n", SDL_GetError());
+            break;
+        }
+        g_num_workers++;
+    }
+    LOG_INFO("Started %i job workers\n", g_num_workers);
+
+    return 0;
+}
+
+void jobs_release(void) {
+    g_jobs_quit = true;
+    for (int32_t i = 0; i < g_num_workers; i++) {
+        SDL_SemPost(g_jobs_start);
+    }
+    for (int32_t i = 0; i < g_num_workers; i++) {
+        SDL_WaitThread(g_workers[i], NULL);
+        g_workers[i] = NULL;
+    }
+    g_num_workers = 0;
+
+    SDL_DestroySemaphore(g_jobs_start);
+    SDL_DestroySemaphore(g_jobs_done);
+    g_jobs_start = NULL;
+    g_jobs_done = NULL;
+}
+
+int32_t jobs_num_threads(void) { return g_num_workers + 1; }
+
+void jobs_parallel_for(int32_t count, int32_t chunk_size, JobFunc func,
+                       void* data) {
+    if (count <= 0) {
+        return;
+    }
+    if (chunk_size < 1) {
+        chunk_size = 1;
+    }
+
+    g_job.func = func;
+    g_job.data = data;
+    g_job.count = count;
+    g_job.chunk_size = chunk_size;
+    SDL_AtomicSet(&g_job.next_chunk, 0);
+
+    // Not worth waking anyone for a single chunk
+    if (count <= chunk_size || g_num_workers == 0) {
+        job_run_chunks(&g_job);
+        return;
+    }
+
+    for (int32_t i = 0; i < g_num_workers; i++) {
+        SDL_SemPost(g_jobs_start);
+    }
+    job_run_chunks(&g_job);
+    for (int32_t i = 0; i < g_num_workers; i++) {
+        SDL_SemWait(g_jobs_done);
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef C_TRIS_JOBS_H_
+#define C_TRIS_JOBS_H_
+
+#include <stdint.h>
+
+// Range [begin, end) of the items handed to jobs_parallel_for.
+typedef void (*JobFunc)(void* data, int32_t begin, int32_t end);
+
+// Starts num_workers background threads, or one less than the number of
+// cores when num_workers is negative. The calling thread always helps out.
+int32_t jobs_init(int32_t num_workers);
+void jobs_release(void);
+
+// Number of threads that take part in a parallel for, including the caller.
+int32_t jobs_num_threads(void);
+
+// Splits [0, count) into chunks of chunk_size and runs func on them across
+// the worker threads. Blocks until every chunk is done. Must only be called
+// from one thread at a time.
+void jobs_parallel_for(int32_t count, int32_t chunk_size, JobFunc func,
+                       void* data);
+
+#endif
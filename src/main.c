@@ -1,9 +1,13 @@
+#include "batch_env.h"
 #include "defs.h"
+#include "export.h"
+#include "game.h"
+#include "jobs.h"
 #include "log.h"
-#include "particles.h"
 #include "render.h"
+#include "sim.h"
 #include "sound.h"
-#include "vec2.h"
+#include "spectator.h"
 
 #include <assert.h>
 #include <SDL.h>
@@ -19,405 +23,113 @@
 #include <SDL_video.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-#define NUM_BRICK_TYPES 7
-typedef enum {
-    EBrickShape_Straight = 0,
-    EBrickShape_Square,
-    EBrickShape_T,
-    EBrickShape_LRight,
-    EBrickShape_LLeft,
-    EBrickShape_RSkew,
-    EBrickShape_LSkew,
-} EBrickShape;
-
-typedef struct {
-    IVec2 pos;
-    IVec2 tiles[4];
-    EColor color;
-} Brick;
-
-EColor get_color_from_shape(EBrickShape shape) {
-    switch (shape) {
-        case EBrickShape_Straight:
-            return EColor_LtBlue;
-        case EBrickShape_Square:
-            return EColor_Pink;
-        case EBrickShape_T:
-            return EColor_Blue;
-        case EBrickShape_LRight:
-            return EColor_Purple;
-        case EBrickShape_LLeft:
-            return EColor_Orange;
-        case EBrickShape_RSkew:
-            return EColor_Red;
-        case EBrickShape_LSkew:
-            return EColor_Green;
-        default:
-            return EColor_None;
-    }
-}
-
-#define NUM_TILES (GAME_TILES_WIDE * GAME_TILES_HIGH)
-
+// Smoothed frame statistics for the performance overlay. Drawing is measured
+// on the render thread, the rest comes with the simulation snapshots.
 typedef struct {
-    EColor tiles[NUM_TILES];
-    Brick current_brick;
-    Brick next_brick;
-    int32_t score;
-} GameState;
-
-typedef enum {
-    ECollision_None = 0,
-    ECollision_Side = 1,
-    ECollision_Bottom = 2,
-} ECollision;
-
-ECollision tiles_check_collision(EColor tiles[], IVec2 brick_tiles[],
-                                 IVec2 new_pos) {
-    for (int32_t i = 0; i < 4; i++) {
-        int32_t const x = new_pos.x + brick_tiles[i].x;
-        int32_t const y = new_pos.y + brick_tiles[i].y;
-
-        if (y >= GAME_TILES_HIGH) {
-            LOG_INFO("Bottom collision on (x,y) = (%i, %i)\n", x, y);
-            return ECollision_Bottom;
-        }
-
-        if (x < 0 || x >= GAME_TILES_WIDE) {
-            LOG_INFO("Side collision on (x,y) = (%i, %i)\n", x, y);
-            return ECollision_Side;
-        }
-
-        int32_t index = y * GAME_TILES_WIDE + x;
-        if (index >= NUM_TILES) {
-            LOG_ERROR("Received out-of-bounds index %i\n", index);
-            assert(NULL);
-        }
-        if (tiles[index] != EColor_None) {
-            return ECollision_Bottom;
-        }
-    }
-
-    return ECollision_None;
-}
-
-Brick create_brick(EBrickShape shape) {
-    Brick brick = {0};
-    brick.color = get_color_from_shape(shape);
-    brick.pos = (IVec2){2 + rand() % (GAME_TILES_WIDE - 4), 0};
-
-    switch (shape) {
-        case EBrickShape_Straight: {
-            LOG_INFO("%s\n", "Creating Straight brick");
-            brick.tiles[0] = (IVec2){.x = -1, .y = 0};
-            brick.tiles[1] = (IVec2){.x = 0, .y = 0};
-            brick.tiles[2] = (IVec2){.x = 1, .y = 0};
-            brick.tiles[3] = (IVec2){.x = 2, .y = 0};
-        } break;
-        case EBrickShape_Square: {
-            LOG_INFO("%s\n", "Creating Square brick");
-            brick.tiles[0] = (IVec2){.x = 0, .y = 0};
-            brick.tiles[1] = (IVec2){.x = 1, .y = 0};
-            brick.tiles[2] = (IVec2){.x = 0, .y = 1};
-            brick.tiles[3] = (IVec2){.x = 1, .y = 1};
-        } break;
-        case EBrickShape_T: {
-            LOG_INFO("%s\n", "Creating T brick");
-            brick.tiles[0] = (IVec2){.x = 0, .y = 0};
-            brick.tiles[1] = (IVec2){.x = -1, .y = 0};
-            brick.tiles[2] = (IVec2){.x = 1, .y = 0};
-            brick.tiles[3] = (IVec2){.x = 0, .y = -1};
-        } break;
-        case EBrickShape_LRight: {
-            LOG_INFO("%s\n", "Creating LRight brick");
-            brick.tiles[0] = (IVec2){.x = -1, .y = 0};
-            brick.tiles[1] = (IVec2){.x = 0, .y = 0};
-            brick.tiles[2] = (IVec2){.x = 1, .y = 0};
-            brick.tiles[3] = (IVec2){.x = 1, .y = -1};
-        } break;
-        case EBrickShape_LLeft: {
-            LOG_INFO("%s\n", "Creating LLeft brick");
-            brick.tiles[0] = (IVec2){.x = -1, .y = 0};
-            brick.tiles[1] = (IVec2){.x = 0, .y = 0};
-            brick.tiles[2] = (IVec2){.x = 1, .y = 0};
-            brick.tiles[3] = (IVec2){.x = 1, .y = 1};
-        } break;
-        case EBrickShape_RSkew: {
-            LOG_INFO("%s\n", "Creating RSkew brick");
-            brick.tiles[0] = (IVec2){.x = -1, .y = 1};
-            brick.tiles[1] = (IVec2){.x = 1, .y = 0};
-            brick.tiles[2] = (IVec2){.x = 0, .y = 0};
-            brick.tiles[3] = (IVec2){.x = 0, .y = 1};
-        } break;
-        case EBrickShape_LSkew: {
-            LOG_INFO("%s\n", "Creating LSkew brick");
-            brick.tiles[0] = (IVec2){.x = -1, .y = 0};
-            brick.tiles[1] = (IVec2){.x = 0, .y = 0};
-            brick.tiles[2] = (IVec2){.x = 0, .y = 1};
-            brick.tiles[3] = (IVec2){.x = 1, .y = 1};
-        } break;
-        default: {
-            assert(false);
-        }
-    }
-    return brick;
-}
-
-// Returns int in range [0, n).
-int32_t rand_n(int32_t max) { return rand() / (RAND_MAX / max + 1); }
-
-Brick create_random_brick(void) {
-    EBrickShape const shape = (EBrickShape)rand_n(NUM_BRICK_TYPES);
-    assert(shape <= NUM_BRICK_TYPES);
-    return create_brick(shape);
-}
-
-void draw_brick(Brick const* brick) {
-    for (int i = 0; i < 4; i++) {
-        IVec2 pos = ivec2_add(brick->pos, brick->tiles[i]);
-        render_draw_tile(pos.x, pos.y, brick->color);
-    }
-}
-
-void draw_brick_preview(Brick const* brick) {
-    IVec2 preview_pos = {.x = 14, .y = 3};
-    for (int i = 0; i < 4; i++) {
-        IVec2 pos = ivec2_add(preview_pos, brick->tiles[i]);
-        render_draw_tile(pos.x, pos.y, brick->color);
-    }
-}
-
-IVec2 tile_index_to_pos(int32_t index) {
-    int32_t x = index % GAME_TILES_WIDE;
-    int32_t y = index / GAME_TILES_WIDE;
-    return (IVec2){.x = x, .y = y};
-}
-
-int32_t pos_to_tile_index(IVec2 pos) { return pos.y * GAME_TILES_WIDE + pos.x; }
-
-void draw_tiles(EColor tiles[]) {
-    for (int i = 0; i < NUM_TILES; i++) {
-        if (tiles[i] == EColor_None) {
-            continue;
-        }
-
-        EColor const color = tiles[i];
-        IVec2 const pos = tile_index_to_pos(i);
-        render_draw_tile(pos.x, pos.y, color);
-    }
-}
-
-bool row_is_empty(EColor* first_index) {
-    for (int32_t x = 0; x < GAME_TILES_WIDE; x++) {
-        EColor const tile = *(first_index + x);
-        if (tile != EColor_None) {
-            return false;
-        }
-    }
-    return true;
-}
-
-int32_t lowest_nonempty_tile_index(EColor* tiles) {
-    for (int32_t i = 0; i < NUM_TILES; i++) {
-        if (tiles[i] != EColor_None) {
-            return i;
-        }
-    }
-    return NUM_TILES - 1;
-}
-
-int32_t min(int32_t lhs, int32_t rhs) { return lhs < rhs ? lhs : rhs; }
-int32_t max(int32_t lhs, int32_t rhs) { return lhs > rhs ? lhs : rhs; }
-
-void spawn_particles(Brick* brick) {
-
-    int32_t max_y = INT32_MIN;
-    for (int32_t i = 0; i < 4; i++) {
-        max_y = max(brick->tiles[i].y, max_y);
-    }
-
-    int32_t min_x = INT32_MAX;
-    int32_t max_x = INT32_MIN;
-    for (int32_t i = 0; i < 4; i++) {
-        if (brick->tiles[i].y == max_y) {
-            min_x = min(min_x, brick->tiles[i].x);
-            max_x = max(max_x, brick->tiles[i].x);
-        }
-    }
-
-    particles_spawn(50, (f32_t)brick->pos.y + (f32_t)max_y + 1.f,
-                    (f32_t)brick->pos.x + (f32_t)min_x,
-                    (f32_t)brick->pos.x + (f32_t)max_x + 1.f);
-}
-
-void game_handle_touchdown(GameState* game, bool with_force) {
-    // 0. Handle force
-    if (with_force) {
-        spawn_particles(&game->current_brick);
-        sound_touchdown();
-    }
-
-    // 1. Move brick tiles to game.tiles
-    for (int32_t i = 0; i < 4; i++) {
-        IVec2 const pos =
-            ivec2_add(game->current_brick.tiles[i], game->current_brick.pos);
-        int32_t tile_index = pos_to_tile_index(pos);
-        game->tiles[tile_index] = game->current_brick.color;
-    }
-
-    // 2. Spawn a new (random) brick
-    EBrickShape const shape = (EBrickShape)rand_n(NUM_BRICK_TYPES);
-    assert(shape <= NUM_BRICK_TYPES);
-    game->current_brick = game->next_brick;
-    game->next_brick = create_random_brick();
-
-    // 3. Rotate next brick
-    int32_t const rotations = rand_n(4);
-    for (int j = 0; j < rotations; j++) {
-        for (int i = 0; i < 4; i++) {
-            game->current_brick.tiles[i] =
-                ivec2_rotate_cw(game->current_brick.tiles[i]);
-        }
+    f32_t frame_ms;
+    f32_t draw_ms;
+    f32_t tick_ms;
+    f32_t particles_ms;
+    bool is_visible;
+} PerfOverlay;
+
+void perf_overlay_update(PerfOverlay* perf, f32_t frame_ms, f32_t draw_ms,
+                         SimSnapshot const* snapshot) {
+    perf->frame_ms += (frame_ms - perf->frame_ms) * 0.05f;
+    perf->draw_ms += (draw_ms - perf->draw_ms) * 0.05f;
+    perf->tick_ms += (snapshot->tick_ms - perf->tick_ms) * 0.05f;
+    perf->particles_ms += (snapshot->particles_ms - perf->particles_ms) * 0.05f;
+}
+
+void perf_overlay_draw(PerfOverlay const* perf, SimSnapshot const* snapshot) {
+    if (!perf->is_visible) {
+        return;
     }
 
-    // 4. Remove full lines
-    int32_t score = 0;
-    for (int32_t y = 0; y < GAME_TILES_HIGH; y++) {
-        int32_t const x_start = y * GAME_TILES_WIDE;
-        int32_t num_occupied = 0;
-        for (int32_t x = 0; x < GAME_TILES_WIDE; x++) {
-            if (game->tiles[x_start + x] == EColor_None) {
-                break;
+    f32_t const fps = perf->frame_ms > 0.f ? 1000.f / perf->frame_ms : 0.f;
+    char text[40];
+    snprintf(text, sizeof(text), "FPS %.0f DRAW %.1fMS SIM %.1fMS",
+             (f64_t)fps, (f64_t)perf->draw_ms, (f64_t)perf->tick_ms);
+    Pixel const yellow = {.r = 255, .g = 220, .b = 0, .a = 255};
+    render_draw_text((f32_t)DPI, (f32_t)DPI, (f32_t)DPI / 2.f, yellow, text);
+
+    // Line clears are single tick spikes, so the peak is shown unsmoothed
+    snprintf(text, sizeof(text), "PFX %i %.1fMS MAX %.1fMS",
+             snapshot->num_particles, (f64_t)perf->particles_ms,
+             (f64_t)snapshot->particles_peak_ms);
+    render_draw_text((f32_t)DPI, (f32_t)(4 * DPI), (f32_t)DPI / 2.f, yellow,
+                     text);
+}
+
+int main(int argc, char* argv[]) {
+    int32_t spectate_cols = 0;
+    int32_t spectate_rows = 0;
+    int32_t table_megabytes = 16;
+    char const* export_path = NULL;
+    int32_t bench_envs = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--spectate") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%ix%i", &spectate_cols, &spectate_rows) !=
+                2) {
+                printf("Expected --spectate COLSxROWS, got %s\n", argv[i]);
+                return 1;
             }
-            if (++num_occupied == GAME_TILES_WIDE) {
-                memset(&game->tiles[x_start], (int32_t)EColor_None,
-                       sizeof(EColor_None) * GAME_TILES_WIDE);
-                score = score * 2 + 1000;
+        } else if (strcmp(argv[i], "--tt-mb") == 0 && i + 1 < argc) {
+            table_megabytes = atoi(argv[++i]);
+            if (table_megabytes <= 0) {
+                printf("Expected a positive --tt-mb, got %s\n", argv[i]);
+                return 1;
             }
+        } else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            export_path = argv[++i];
+        } else if (strcmp(argv[i], "--bench-batch") == 0 && i + 1 < argc) {
+            bench_envs = atoi(argv[++i]);
         }
     }
-    game->score += score;
+    bool const is_spectating = spectate_cols > 0 && spectate_rows > 0;
 
-    // 5. Pack tiles
-    if (score > 0) {
-        for (int32_t y0 = GAME_TILES_HIGH - 1; y0 > 0; y0--) {
-            int32_t const x_start = y0 * GAME_TILES_WIDE;
-            while (row_is_empty(&game->tiles[x_start]) &&
-                   lowest_nonempty_tile_index(game->tiles) < x_start) {
-                for (int32_t y1 = y0; y1 > 0; y1--) {
-                    int32_t const dst = y1 * GAME_TILES_WIDE;
-                    int32_t const src = (y1 - 1) * GAME_TILES_WIDE;
-                    LOG_INFO("Packing: Moving %i to %i\n", src, dst);
-                    memcpy(&game->tiles[dst], &game->tiles[src],
-                           sizeof(game->tiles[0]) * GAME_TILES_WIDE);
-                }
-            }
-        }
+    // Headless, no window needed
+    if (bench_envs > 0) {
+        jobs_init(-1);
+        batch_env_benchmark(bench_envs, 1000);
+        jobs_release();
+        return 0;
     }
-}
-
-void game_handle_down_movement(GameState* game, bool with_force) {
-    Brick* b = &game->current_brick;
-    EColor* t = game->tiles;
-
-    IVec2 new_pos = b->pos;
-    new_pos.y += 1;
-
-    ECollision const collision = tiles_check_collision(t, b->tiles, new_pos);
-    if (collision == ECollision_None) {
-        b->pos = new_pos;
-    } else if (collision == ECollision_Side) {
-        assert(NULL);
-    } else if (collision == ECollision_Bottom) {
-        game_handle_touchdown(game, with_force);
-    }
-}
 
-typedef enum {
-    ERotation_CW = 0,
-    ERotation_CCW,
-} ERotation;
-
-void brick_rotate(GameState* game, ERotation rot) {
-    IVec2 new_tiles[4] = {0};
-    for (int i = 0; i < 4; i++) {
-        IVec2 const tile_pos = game->current_brick.tiles[i];
-        if (rot == ERotation_CW) {
-            new_tiles[i] = ivec2_rotate_cw(tile_pos);
-        } else {
-            new_tiles[i] = ivec2_rotate_ccw(tile_pos);
-        }
-    }
-
-    ECollision const collision =
-        tiles_check_collision(game->tiles, new_tiles, game->current_brick.pos);
-    if (collision == ECollision_Bottom) {
-        return;
+    if (render_init() != 0) {
+        printf("%s\n", SDL_GetError());
+        goto quit;
     }
-
-    // Move sideways until we fit
-    if (collision == ECollision_Side) {
-        int32_t offset[4] = {1, -1, 2, -2};
-        for (int32_t i = 0; i < 4; i++) {
-            IVec2 offseted_pos = game->current_brick.pos;
-            offseted_pos.x += offset[i];
-            if (ECollision_None ==
-                tiles_check_collision(game->tiles, new_tiles, offseted_pos)) {
-                game->current_brick.pos = offseted_pos;
-                break;
-            }
-        }
+    sound_init();
+    jobs_init(-1);
+    if (export_path != NULL && export_open(export_path) != 0) {
+        goto quit;
     }
+    uint32_t const seed = (uint32_t)time(NULL);
 
-    memcpy(game->current_brick.tiles, new_tiles, 4 * sizeof(IVec2));
-}
+    BoardView const view = render_default_board_view();
 
-void move_sideway(GameState* game, int32_t dy) {
-    IVec2 new_pos = game->current_brick.pos;
-    new_pos.x += dy;
-    if (ECollision_None == tiles_check_collision(game->tiles,
-                                                 game->current_brick.tiles,
-                                                 new_pos)) {
-        game->current_brick.pos = new_pos;
+    if (is_spectating &&
+        spectator_init(spectate_cols, spectate_rows, seed,
+                       (size_t)table_megabytes * 1024 * 1024) != 0) {
+        goto quit;
     }
-}
-
-uint32_t g_movement_interval = 800;
-uint32_t g_timer_trigger_event = 0;
-
-uint32_t timer_callback(uint32_t interval, void* data) {
-    (void)data;
-    (void)interval;
-    SDL_Event event = {0};
-    event.type = g_timer_trigger_event;
-    SDL_PushEvent(&event);
-    return g_movement_interval;
-}
-
-int main(void) {
-    if (render_init() != 0) {
-        printf("%s\n", SDL_GetError());
+    if (sim_start(seed, is_spectating) != 0) {
         goto quit;
     }
-    sound_init();
-    srand((uint32_t)time(NULL));
-
-    GameState game = {0};
-    game.current_brick = create_random_brick();
-    game.next_brick = create_random_brick();
 
     uint32_t delta_ticks = 0;
     uint32_t const target_frame_ticks = 16;
-
-    SDL_AddTimer(g_movement_interval, timer_callback, NULL);
-    g_timer_trigger_event = SDL_RegisterEvents(1);
+    PerfOverlay perf = {.is_visible = is_spectating};
 
     SDL_Event event = {0};
     while (1) {
         uint32_t const frame_start = SDL_GetTicks();
-        bool with_down_force = false;
 
         while (SDL_PollEvent(&event)) {
             switch (event.type) {
@@ -431,52 +143,70 @@ int main(void) {
                         } break;
                         case SDLK_LEFT:
                         case SDLK_a: {
-                            move_sideway(&game, -1);
+                            sim_push_input(ESimInput_Left);
                         } break;
                         case SDLK_RIGHT:
                         case SDLK_d: {
-                            move_sideway(&game, 1);
+                            sim_push_input(ESimInput_Right);
                         } break;
                         case SDLK_DOWN:
                         case SDLK_s: {
-                            with_down_force = true;
-                            game_handle_down_movement(&game, with_down_force);
+                            sim_push_input(ESimInput_SoftDrop);
+                        } break;
+                        case SDLK_SPACE: {
+                            // Holding the key should not drop every brick
+                            if (!event.key.repeat) {
+                                sim_push_input(ESimInput_HardDrop);
+                            }
                         } break;
                         case SDLK_z: {
-                            brick_rotate(&game, ERotation_CCW);
+                            sim_push_input(ESimInput_RotateCCW);
                         } break;
                         case SDLK_x: {
-                            brick_rotate(&game, ERotation_CW);
+                            sim_push_input(ESimInput_RotateCW);
+                        } break;
+                        case SDLK_F3: {
+                            perf.is_visible = !perf.is_visible;
                         }
                     }
                 } break;
             }
-            if (event.type == g_timer_trigger_event) {
-                game_handle_down_movement(&game, with_down_force);
-            }
         }
 
-        render_draw_background();
-        draw_tiles(game.tiles);
-        draw_brick(&game.current_brick);
-        draw_brick_preview(&game.next_brick);
-        f32_t const delta_time = (f32_t)delta_ticks / 1000.f;
-        particles_update(delta_time);
+        uint64_t const draw_start = SDL_GetPerformanceCounter();
+        SimSnapshot const* snapshot = sim_latest_snapshot();
+        if (is_spectating) {
+            spectator_draw(snapshot->games, &snapshot->table_stats);
+        } else {
+            GameState const* game = &snapshot->games[0];
+            render_draw_background();
+            game_draw(game, &view, true);
+            game_draw_hud(game, &view);
+            render_particles(&view, snapshot->particles_x,
+                             snapshot->particles_y, snapshot->num_particles);
+        }
+        perf_overlay_draw(&perf, snapshot);
 
+        uint64_t const draw_end = SDL_GetPerformanceCounter();
         render_present();
 
+        // Sleep rather than spin, the simulation thread may share this core
         uint32_t const frame_end = SDL_GetTicks();
         delta_ticks = frame_end - frame_start;
         if (delta_ticks < target_frame_ticks) {
-            uint32_t const continue_at = frame_end + target_frame_ticks;
+            SDL_Delay(target_frame_ticks - delta_ticks);
             delta_ticks = target_frame_ticks;
-            while (SDL_GetTicks() < continue_at) {
-                // Spin lock: do nothing
-            }
         }
+        f32_t const draw_ms = (f32_t)(draw_end - draw_start) * 1000.f /
+                              (f32_t)SDL_GetPerformanceFrequency();
+        perf_overlay_update(&perf, (f32_t)delta_ticks, draw_ms, snapshot);
     }
 
 quit:
+    sim_stop();
+    export_close();
+    spectator_release();
+    jobs_release();
     sound_release();
     render_drop();
 
@@ -1,61 +1,243 @@
 #include "particles.h"
 
+#include "jobs.h"
 #include "log.h"
-#include "render.h"
 
 #include <SDL_stdinc.h>
-#include <stdlib.h>
+#include <SDL_timer.h>
+#include <assert.h>
+#include <string.h>
 
-Particle g_particles[MAX_PARTICLES] = {0};
+// Chunks handed to the job pool, large enough to make the hand-off cheap
+#define PARTICLE_CHUNK 8192
+// Emitting does more math per particle, smaller chunks keep every worker busy
+// even for a single burst
+#define EMIT_CHUNK 2048
+#define NUM_PARTICLE_CHUNKS                                                    \
+    ((MAX_PARTICLES + PARTICLE_CHUNK - 1) / PARTICLE_CHUNK)
+// Particles are 2x2 pixels, so they touch the floor a quarter tile early
+#define PARTICLE_FLOOR ((f32_t)GAME_TILES_HIGH - 2.f / (f32_t)TILE_SIZE)
 
-f32_t randf_in_range(f32_t min, f32_t max) {
-    f32_t span = max - min;
-    return min + (f32_t)rand() / ((f32_t)RAND_MAX / span);
+// Structure of arrays so that updates stream through memory
+typedef struct {
+    f32_t x[MAX_PARTICLES];
+    f32_t y[MAX_PARTICLES];
+    f32_t x_vel[MAX_PARTICLES];
+    f32_t y_vel[MAX_PARTICLES];
+    f32_t age[MAX_PARTICLES];
+    f32_t lifetime[MAX_PARTICLES];
+} Particles;
+
+Particles g_particles = {0};
+// Spawning walks around the arrays like a ring buffer
+int32_t g_next_particle = 0;
+uint32_t g_particle_seed = 1;
+// Nothing to update once every particle has had time to die
+f32_t g_time_since_spawn = MAX_LIFETIME;
+
+// Positions of live particles after the last update, packed for drawing
+f32_t g_live_x[MAX_PARTICLES];
+f32_t g_live_y[MAX_PARTICLES];
+int32_t g_num_live = 0;
+int32_t g_chunk_live[NUM_PARTICLE_CHUNKS] = {0};
+
+// Performance counter ticks spent emitting and updating since last taken
+uint64_t g_particle_work = 0;
+
+static uint32_t particle_rand(uint32_t* rng_state) {
+    uint32_t x = *rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *rng_state = x;
+    return x;
 }
 
-int32_t particles_spawn(int32_t num, f32_t y, f32_t x_min, f32_t x_max) {
-    int32_t num_spawned = 0;
-    for (int i = 0; i < MAX_PARTICLES && num_spawned <= num; i++) {
-        if (g_particles[i].is_alive == false) {
-            num_spawned++;
-
-            f32_t const angle = randf_in_range(-1.f, 1.f); // Radians
-            f32_t const speed = randf_in_range(MIN_VELOCITY, MAX_VELOCITY);
-            f32_t const x = randf_in_range(x_min, x_max);
-            // LOG_INFO("Spawning particle at (%f, %f)\n'", x, y);
-
-            g_particles[i] = (Particle){
-                .lifetime = randf_in_range(MIN_LIFETIME, MAX_LIFETIME),
-                .age = 0.0,
-                .x = x,
-                .y = y,
-                .x_vel = SDL_sinf(angle) * speed,
-                .y_vel = -(SDL_cosf(angle) * speed),
-                .is_alive = true};
-        }
+f32_t randf_in_range(uint32_t* rng_state, f32_t min, f32_t max) {
+    f32_t const unit = (f32_t)(particle_rand(rng_state) >> 8) / 16777216.f;
+    return min + unit * (max - min);
+}
+
+// Taylor series, accurate to 1e-4 for the angles emitters use (|x| <= 1.6).
+// Much cheaper than a libm call per particle.
+static f32_t approx_sinf(f32_t x) {
+    f32_t const x2 = x * x;
+    return x * (1.f - x2 / 6.f * (1.f - x2 / 20.f * (1.f - x2 / 42.f *
+                                                        (1.f - x2 / 72.f))));
+}
+
+static f32_t approx_cosf(f32_t x) {
+    f32_t const x2 = x * x;
+    return 1.f - x2 / 2.f * (1.f - x2 / 12.f * (1.f - x2 / 30.f *
+                                                   (1.f - x2 / 56.f)));
+}
+
+// Particle n comes from emitters[n / num_each].
+typedef struct {
+    ParticleEmitter const* emitters;
+    int32_t num_each;
+    int32_t first;
+    uint32_t seed;
+} EmitJob;
+
+static void emit_particles(void* data, int32_t begin, int32_t end) {
+    EmitJob const* job = data;
+    uint32_t rng_state = (job->seed ^ ((uint32_t)begin * 0x9e3779b9)) | 1;
+    Particles* p = &g_particles;
+
+    int32_t i = (job->first + begin) % MAX_PARTICLES;
+    for (int32_t n = begin; n < end; n++, i++) {
+        ParticleEmitter const* emitter = &job->emitters[n / job->num_each];
+        i = i == MAX_PARTICLES ? 0 : i;
+        f32_t const angle = randf_in_range(&rng_state, -emitter->angle_spread,
+                                           emitter->angle_spread); // Radians
+        f32_t const speed = randf_in_range(&rng_state, emitter->min_speed,
+                                           emitter->max_speed);
+
+        p->x[i] = randf_in_range(&rng_state, emitter->x_min, emitter->x_max);
+        p->y[i] = randf_in_range(&rng_state, emitter->y_min, emitter->y_max);
+        p->x_vel[i] = approx_sinf(angle) * speed;
+        p->y_vel[i] = -(approx_cosf(angle) * speed);
+        p->age[i] = 0.f;
+        p->lifetime[i] = randf_in_range(&rng_state, emitter->min_lifetime,
+                                        emitter->max_lifetime);
     }
+}
 
-    return num_spawned;
+// Emits num_each particles from every emitter in one parallel for.
+static int32_t emit_from(ParticleEmitter const emitters[],
+                         int32_t num_emitters, int32_t num_each) {
+    uint64_t const start = SDL_GetPerformanceCounter();
+    int32_t num = num_emitters * num_each;
+    for (int32_t i = 0; i < num_emitters; i++) {
+        assert(emitters[i].angle_spread <= 1.6f);
+    }
+    if (num > MAX_PARTICLES) {
+        num = MAX_PARTICLES;
+    }
+
+    EmitJob job = {.emitters = emitters,
+                   .num_each = num_each,
+                   .first = g_next_particle,
+                   .seed = particle_rand(&g_particle_seed)};
+    jobs_parallel_for(num, EMIT_CHUNK, emit_particles, &job);
+
+    g_next_particle = (g_next_particle + num) % MAX_PARTICLES;
+    g_time_since_spawn = 0.f;
+    g_particle_work += SDL_GetPerformanceCounter() - start;
+    return num;
 }
 
-void particle_update(Particle* particle, f32_t delta_time) {
+int32_t particles_emit(ParticleEmitter const* emitter, int32_t num) {
+    return emit_from(emitter, 1, num);
+}
 
-    particle->age += delta_time;
-    if (particle->age > particle->lifetime) {
-        particle->is_alive = false;
-        return;
+int32_t particles_spawn(int32_t num, f32_t y, f32_t x_min, f32_t x_max) {
+    ParticleEmitter const emitter = {.x_min = x_min,
+                                     .x_max = x_max,
+                                     .y_min = y,
+                                     .y_max = y,
+                                     .angle_spread = 1.f,
+                                     .min_speed = MIN_VELOCITY,
+                                     .max_speed = MAX_VELOCITY,
+                                     .min_lifetime = MIN_LIFETIME,
+                                     .max_lifetime = MAX_LIFETIME};
+    return particles_emit(&emitter, num);
+}
+
+void particles_emit_line_clear(int32_t const rows[], int32_t num_rows) {
+    assert(num_rows > 0 && num_rows <= 4);
+    bool const is_tetris = num_rows >= 4;
+    ParticleEmitter emitters[4];
+    for (int32_t i = 0; i < num_rows; i++) {
+        emitters[i] = (ParticleEmitter){
+            .x_min = 0.f,
+            .x_max = (f32_t)GAME_TILES_WIDE,
+            .y_min = (f32_t)rows[i],
+            .y_max = (f32_t)rows[i] + 1.f,
+            .angle_spread = is_tetris ? 1.5f : 1.2f,
+            .min_speed = MIN_VELOCITY,
+            .max_speed = is_tetris ? 3.f * MAX_VELOCITY : 2.f * MAX_VELOCITY,
+            .min_lifetime = MIN_LIFETIME,
+            .max_lifetime = MAX_LIFETIME};
     }
+    emit_from(emitters, num_rows,
+              is_tetris ? 2 * PARTICLES_PER_LINE_CLEAR
+                        : PARTICLES_PER_LINE_CLEAR);
+}
+
+typedef struct {
+    f32_t delta_time;
+} UpdateJob;
+
+static void update_particles(void* data, int32_t begin, int32_t end) {
+    f32_t const dt = ((UpdateJob const*)data)->delta_time;
+    Particles* p = &g_particles;
+
+    int32_t num_live = 0;
+    for (int32_t i = begin; i < end; i++) {
+        p->age[i] += dt;
+        p->x[i] += p->x_vel[i] * dt;
+        p->y[i] += p->y_vel[i] * dt;
+        p->y_vel[i] += GRAVITY * dt;
 
-    particle->x += particle->x_vel * delta_time;
-    particle->y += particle->y_vel * delta_time;
-    particle->y_vel += GRAVITY * delta_time;
+        bool const hits_floor = p->y[i] > PARTICLE_FLOOR && p->y_vel[i] > 0.f;
+        p->y[i] = hits_floor ? PARTICLE_FLOOR : p->y[i];
+        p->y_vel[i] = hits_floor ? -p->y_vel[i] * FLOOR_BOUNCE : p->y_vel[i];
+        p->x_vel[i] = hits_floor ? p->x_vel[i] * FLOOR_FRICTION : p->x_vel[i];
+
+        num_live += p->age[i] < p->lifetime[i];
+    }
+    g_chunk_live[begin / PARTICLE_CHUNK] = num_live;
 }
 
-void particles_update(f32_t delta_time) {
-    for (int32_t i = 0; i < MAX_PARTICLES; i++) {
-        if (g_particles[i].is_alive) {
-            particle_update(&g_particles[i], delta_time);
-            render_particle(g_particles[i].x, g_particles[i].y);
+static void pack_live_particles(void* data, int32_t begin, int32_t end) {
+    (void)data;
+    Particles const* p = &g_particles;
+
+    // Chunks are written one after the other
+    int32_t out = 0;
+    for (int32_t chunk = 0; chunk < begin / PARTICLE_CHUNK; chunk++) {
+        out += g_chunk_live[chunk];
+    }
+    for (int32_t i = begin; i < end; i++) {
+        if (p->age[i] < p->lifetime[i]) {
+            g_live_x[out] = p->x[i];
+            g_live_y[out] = p->y[i];
+            out++;
         }
     }
 }
+
+void particles_update(f32_t delta_time) {
+    if (g_time_since_spawn >= MAX_LIFETIME) {
+        g_num_live = 0;
+        return;
+    }
+    g_time_since_spawn += delta_time;
+    uint64_t const start = SDL_GetPerformanceCounter();
+
+    UpdateJob job = {.delta_time = delta_time};
+    jobs_parallel_for(MAX_PARTICLES, PARTICLE_CHUNK, update_particles, &job);
+    jobs_parallel_for(MAX_PARTICLES, PARTICLE_CHUNK, pack_live_particles,
+                      NULL);
+
+    g_num_live = 0;
+    for (int32_t chunk = 0; chunk < NUM_PARTICLE_CHUNKS; chunk++) {
+        g_num_live += g_chunk_live[chunk];
+    }
+    g_particle_work += SDL_GetPerformanceCounter() - start;
+}
+
+int32_t particles_copy_live(f32_t* xs, f32_t* ys) {
+    memcpy(xs, g_live_x, (size_t)g_num_live * sizeof(f32_t));
+    memcpy(ys, g_live_y, (size_t)g_num_live * sizeof(f32_t));
+    return g_num_live;
+}
+
+f32_t particles_take_work_ms(void) {
+    f32_t const ms = (f32_t)g_particle_work * 1000.f /
+                     (f32_t)SDL_GetPerformanceFrequency();
+    g_particle_work = 0;
+    return ms;
+}
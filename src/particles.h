@@ -12,19 +12,39 @@
 #define MAX_LIFETIME 2.f
 #define MIN_VELOCITY 0.5f
 #define MAX_VELOCITY 2.f
-#define MAX_PARTICLES 200
+#define MAX_PARTICLES 100000
+// Share of the vertical speed that is kept when bouncing off the floor
+#define FLOOR_BOUNCE 0.4f
+#define FLOOR_FRICTION 0.8f
+#define PARTICLES_PER_LINE_CLEAR 12000
 
+// Positions are in board tiles. Particles are spawned in an area and fly
+// off within angle_spread radians of straight up, at most 1.6. Lifetimes are
+// expected to stay below MAX_LIFETIME.
 typedef struct {
-    f32_t lifetime;
-    f32_t age;
-    f32_t x;
-    f32_t y;
-    f32_t x_vel;
-    f32_t y_vel;
-    bool is_alive;
-} Particle;
+    f32_t x_min;
+    f32_t x_max;
+    f32_t y_min;
+    f32_t y_max;
+    f32_t angle_spread;
+    f32_t min_speed;
+    f32_t max_speed;
+    f32_t min_lifetime;
+    f32_t max_lifetime;
+} ParticleEmitter;
 
+// Once MAX_PARTICLES are alive the oldest ones are replaced.
+int32_t particles_emit(ParticleEmitter const* emitter, int32_t num);
 int32_t particles_spawn(int32_t num, f32_t y, f32_t x_min, f32_t x_max);
+// Burst across the full width of every cleared row, bigger for four rows.
+// All rows are emitted together so that the job pool shares the work.
+void particles_emit_line_clear(int32_t const rows[], int32_t num_rows);
+
+// Updates on the job pool and collects the positions of live particles.
 void particles_update(f32_t delta_time);
+// Copies the positions collected by the last update, returns their number.
+int32_t particles_copy_live(f32_t* xs, f32_t* ys);
+// Time spent emitting and updating since the last call.
+f32_t particles_take_work_ms(void);
 
 #endif
@@ -1,6 +1,8 @@
 #include "render.h"
 
+#include "atlas.h"
 #include "defs.h"
+#include "font.h"
 #include "log.h"
 
 #include <SDL.h>
@@ -8,11 +10,79 @@
 #include <SDL_pixels.h>
 #include <SDL_render.h>
 
+typedef enum {
+    ESprite_Background = 0,
+    ESprite_Tiles,
+    ESprite_Pixel,
+    ESprite_Font,
+    ESprite_MAX
+} ESprite;
+
 SDL_Window* g_window = NULL;
 SDL_Renderer* g_renderer = NULL;
-SDL_Texture* g_texture_background = NULL;
-SDL_Texture* g_texture_tile = NULL;
-SDL_Texture* g_texture_particle = NULL;
+
+// Everything is drawn from one texture so that a frame can be sent to the GPU
+// without any texture or draw state switches.
+SDL_Texture* g_texture_atlas = NULL;
+f32_t g_atlas_width = 1.f;
+f32_t g_atlas_height = 1.f;
+SDL_Rect g_sprite_rects[ESprite_MAX] = {0};
+
+// Quads are queued up and sent with one SDL_RenderGeometry call per
+// MAX_BATCH_QUADS, instead of one copy per sprite.
+#define MAX_BATCH_QUADS 16384
+SDL_Vertex g_batch_vertices[MAX_BATCH_QUADS * 4];
+int g_batch_indices[MAX_BATCH_QUADS * 6];
+int32_t g_batch_num_quads = 0;
+
+static SDL_Surface* create_pixel_surface(void) {
+    SDL_Surface* pixel =
+        SDL_CreateRGBSurfaceWithFormat(0, 2, 2, 32, SDL_PIXELFORMAT_RGBA32);
+    if (pixel != NULL) {
+        SDL_FillRect(pixel, NULL,
+                     SDL_MapRGBA(pixel->format, 255, 255, 255, 255));
+    }
+    return pixel;
+}
+
+static int32_t create_atlas(void) {
+    AtlasSprite sprites[ESprite_MAX] = {0};
+    sprites[ESprite_Background].surface =
+        IMG_Load("assets/background_01.png");
+    sprites[ESprite_Tiles].surface = IMG_Load("assets/tiles_01.png");
+    sprites[ESprite_Pixel].surface = create_pixel_surface();
+    sprites[ESprite_Font].surface = font_create_surface();
+
+    int32_t result = 0;
+    for (int32_t i = 0; i < ESprite_MAX; i++) {
+        if (sprites[i].surface == NULL) {
+            result = 1;
+        }
+    }
+
+    SDL_Surface* atlas = NULL;
+    if (result == 0) {
+        atlas = atlas_build(sprites, ESprite_MAX);
+    }
+    if (atlas != NULL) {
+        g_texture_atlas = SDL_CreateTextureFromSurface(g_renderer, atlas);
+        g_atlas_width = (f32_t)atlas->w;
+        g_atlas_height = (f32_t)atlas->h;
+        SDL_FreeSurface(atlas);
+    }
+    if (g_texture_atlas == NULL) {
+        result = 1;
+    } else {
+        SDL_SetTextureBlendMode(g_texture_atlas, SDL_BLENDMODE_BLEND);
+    }
+
+    for (int32_t i = 0; i < ESprite_MAX; i++) {
+        g_sprite_rects[i] = sprites[i].rect;
+        SDL_FreeSurface(sprites[i].surface);
+    }
+
+    return result;
+}
 
 int32_t render_init(void) {
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_AUDIO) != 0) {
@@ -32,85 +102,172 @@ int32_t render_init(void) {
         return 1;
     }
 
-    SDL_Surface* background = IMG_Load("assets/background_01.png");
-    g_texture_background = SDL_CreateTextureFromSurface(g_renderer, background);
-    if (background == NULL) {
+    if (create_atlas() != 0) {
         return 1;
     }
-    SDL_FreeSurface(background);
 
-    SDL_Surface* tiles = IMG_Load("assets/tiles_01.png");
-    if (tiles == NULL) {
-        return 1;
+    // Every quad is two triangles over its four corners
+    int const corners[6] = {0, 1, 2, 2, 1, 3};
+    for (int i = 0; i < MAX_BATCH_QUADS; i++) {
+        for (int j = 0; j < 6; j++) {
+            g_batch_indices[i * 6 + j] = i * 4 + corners[j];
+        }
     }
-    g_texture_tile = SDL_CreateTextureFromSurface(g_renderer, tiles);
-    SDL_FreeSurface(tiles);
-
-    // g_texture_particle = SDL_CreateTexture(g_renderer,
-    // SDL_PIXELFORMAT_RGBA32,
-    //                                        SDL_TEXTUREACCESS_STATIC, 2, 2);
-    // SDL_Color particle_pixels[4] = {
-    //     (SDL_Color){.a = 255, .r = 255, .g = 255, .b = 255},
-    //     (SDL_Color){.a = 255, .r = 255, .g = 255, .b = 255},
-    //     (SDL_Color){.a = 255, .r = 255, .g = 255, .b = 255},
-    //     (SDL_Color){.a = 255, .r = 255, .g = 255, .b = 255}};
-    // SDL_UpdateTexture(g_texture_particle, NULL, particle_pixels,
-    //                   sizeof(SDL_Color));
 
     return 0;
 }
 
 void render_drop(void) {
-    SDL_DestroyTexture(g_texture_background);
-    SDL_DestroyTexture(g_texture_tile);
-    // SDL_DestroyTexture(g_texture_particle);
+    SDL_DestroyTexture(g_texture_atlas);
     SDL_DestroyRenderer(g_renderer);
     SDL_DestroyWindow(g_window);
     IMG_Quit();
     SDL_Quit();
 }
 
-void render_draw_background(void) {
-    int r = SDL_RenderCopy(g_renderer, g_texture_background, NULL, NULL);
+static void render_flush(void) {
+    if (g_batch_num_quads == 0) {
+        return;
+    }
+
+    int r = SDL_RenderGeometry(g_renderer, g_texture_atlas, g_batch_vertices,
+                               g_batch_num_quads * 4, g_batch_indices,
+                               g_batch_num_quads * 6);
     if (r != 0) {
         printf("%s\n", SDL_GetError());
     }
+    g_batch_num_quads = 0;
 }
 
-void render_draw_tile(int32_t x_pos, int32_t y_pos, EColor color) {
+static void batch_quad(SDL_FRect const* dst, SDL_Rect const* src,
+                       Pixel color) {
+    if (g_batch_num_quads == MAX_BATCH_QUADS) {
+        render_flush();
+    }
+
+    f32_t const u0 = (f32_t)src->x / g_atlas_width;
+    f32_t const v0 = (f32_t)src->y / g_atlas_height;
+    f32_t const u1 = (f32_t)(src->x + src->w) / g_atlas_width;
+    f32_t const v1 = (f32_t)(src->y + src->h) / g_atlas_height;
+
+    f32_t const x0 = dst->x;
+    f32_t const y0 = dst->y;
+    f32_t const x1 = dst->x + dst->w;
+    f32_t const y1 = dst->y + dst->h;
+
+    SDL_Vertex* v = &g_batch_vertices[g_batch_num_quads * 4];
+    v[0] = (SDL_Vertex){{x0, y0}, color, {u0, v0}};
+    v[1] = (SDL_Vertex){{x1, y0}, color, {u1, v0}};
+    v[2] = (SDL_Vertex){{x0, y1}, color, {u0, v1}};
+    v[3] = (SDL_Vertex){{x1, y1}, color, {u1, v1}};
+    g_batch_num_quads++;
+}
+
+BoardView render_default_board_view(void) {
+    return (BoardView){
+        .x = (f32_t)(GAME_BOARD_X * DPI), .y = 0.f, .scale = (f32_t)DPI};
+}
+
+void render_clear(void) {
+    render_flush();
+    SDL_SetRenderDrawColor(g_renderer, 0, 0, 0, 255);
+    SDL_RenderClear(g_renderer);
+}
+
+void render_draw_background(void) {
+    SDL_FRect const dst = {.x = 0.f,
+                           .y = 0.f,
+                           .w = (f32_t)(UNSCALED_WINDOW_WIDTH * DPI),
+                           .h = (f32_t)(UNSCALED_WINDOW_HEIGHT * DPI)};
+    Pixel const white = {.r = 255, .g = 255, .b = 255, .a = 255};
+    batch_quad(&dst, &g_sprite_rects[ESprite_Background], white);
+}
+
+static void draw_tile(BoardView const* view, int32_t x_pos, int32_t y_pos,
+                      EColor color, Pixel tint) {
     // Source
-    int32_t const src_x = (int32_t)color * TILE_SIZE;
-    SDL_Rect const src = {.x = src_x, .y = 0, .w = TILE_SIZE, .h = TILE_SIZE};
+    SDL_Rect const* tiles = &g_sprite_rects[ESprite_Tiles];
+    SDL_Rect const src = {.x = tiles->x + (int32_t)color * TILE_SIZE,
+                          .y = tiles->y,
+                          .w = TILE_SIZE,
+                          .h = TILE_SIZE};
 
     // Dest
-    int32_t dst_x = 80;
-    dst_x += x_pos * TILE_SIZE;
-    int32_t const dst_y = y_pos * TILE_SIZE;
+    f32_t const size = (f32_t)TILE_SIZE * view->scale;
+    SDL_FRect const dst = {.x = view->x + (f32_t)x_pos * size,
+                           .y = view->y + (f32_t)y_pos * size,
+                           .w = size,
+                           .h = size};
 
-    SDL_Rect const dst = {.x = dst_x * DPI,
-                          .y = dst_y * DPI,
-                          .w = TILE_SIZE * DPI,
-                          .h = TILE_SIZE * DPI};
-    int r = SDL_RenderCopy(g_renderer, g_texture_tile, &src, &dst);
+    batch_quad(&dst, &src, tint);
+}
 
-    if (r != 0) {
-        printf("%s\n", SDL_GetError());
-    }
+void render_draw_tile(BoardView const* view, int32_t x_pos, int32_t y_pos,
+                      EColor color) {
+    Pixel const white = {.r = 255, .g = 255, .b = 255, .a = 255};
+    draw_tile(view, x_pos, y_pos, color, white);
 }
 
-void render_particle(f32_t x, f32_t y) {
-    SDL_SetRenderDrawColor(g_renderer, 255, 255, 255, 255);
-    f32_t const game_board_tile_offset = 10.f;
+void render_draw_ghost_tile(BoardView const* view, int32_t x_pos,
+                            int32_t y_pos, EColor color) {
+    Pixel const faded = {.r = 255, .g = 255, .b = 255, .a = 72};
+    draw_tile(view, x_pos, y_pos, color, faded);
+}
+
+void render_particles(BoardView const* view, f32_t const* xs,
+                      f32_t const* ys, int32_t num_particles) {
+    // Same source and color for all of them, only the positions change
+    SDL_Rect const* src = &g_sprite_rects[ESprite_Pixel];
+    f32_t const u0 = (f32_t)src->x / g_atlas_width;
+    f32_t const v0 = (f32_t)src->y / g_atlas_height;
+    f32_t const u1 = (f32_t)(src->x + src->w) / g_atlas_width;
+    f32_t const v1 = (f32_t)(src->y + src->h) / g_atlas_height;
+    Pixel const white = {.r = 255, .g = 255, .b = 255, .a = 255};
+
+    f32_t const tile_size = (f32_t)TILE_SIZE * view->scale;
+    f32_t const size = 2.f * view->scale;
 
-    f32_t const x_window =
-        (game_board_tile_offset + x) * (f32_t)TILE_SIZE * (f32_t)DPI;
-    f32_t const y_window = y * (f32_t)TILE_SIZE * (f32_t)DPI;
-    f32_t const size = 2.f * (f32_t)DPI;
+    for (int32_t i = 0; i < num_particles; i++) {
+        if (g_batch_num_quads == MAX_BATCH_QUADS) {
+            render_flush();
+        }
 
-    // LOG_INFO("Drawing particle at (%f, %f)\n", x_window, y_window);
+        f32_t const x0 = view->x + xs[i] * tile_size;
+        f32_t const y0 = view->y + ys[i] * tile_size;
+        f32_t const x1 = x0 + size;
+        f32_t const y1 = y0 + size;
 
-    SDL_FRect const rect = {.x = x_window, .y = y_window, .w = size, .h = size};
-    SDL_RenderFillRectF(g_renderer, &rect);
+        SDL_Vertex* v = &g_batch_vertices[g_batch_num_quads * 4];
+        v[0] = (SDL_Vertex){{x0, y0}, white, {u0, v0}};
+        v[1] = (SDL_Vertex){{x1, y0}, white, {u1, v0}};
+        v[2] = (SDL_Vertex){{x0, y1}, white, {u0, v1}};
+        v[3] = (SDL_Vertex){{x1, y1}, white, {u1, v1}};
+        g_batch_num_quads++;
+    }
 }
 
-void render_present(void) { SDL_RenderPresent(g_renderer); }
+void render_draw_text(f32_t x, f32_t y, f32_t scale, Pixel color,
+                      char const* text) {
+    SDL_Rect const* font = &g_sprite_rects[ESprite_Font];
+    for (char const* c = text; *c != '\0'; c++) {
+        int32_t const glyph = font_glyph_index(*c);
+        if (glyph != 0) {
+            SDL_Rect const src = {
+                .x = font->x + (glyph % FONT_GLYPHS_PER_ROW) * FONT_CELL_WIDTH,
+                .y = font->y + (glyph / FONT_GLYPHS_PER_ROW) * FONT_CELL_HEIGHT,
+                .w = FONT_GLYPH_WIDTH,
+                .h = FONT_GLYPH_HEIGHT};
+            SDL_FRect const dst = {.x = x,
+                                   .y = y,
+                                   .w = (f32_t)FONT_GLYPH_WIDTH * scale,
+                                   .h = (f32_t)FONT_GLYPH_HEIGHT * scale};
+            batch_quad(&dst, &src, color);
+        }
+        x += (f32_t)FONT_CELL_WIDTH * scale;
+    }
+}
+
+void render_present(void) {
+    render_flush();
+    SDL_RenderPresent(g_renderer);
+}
@@ -21,14 +21,34 @@ typedef enum {
     EColor_MAX
 } EColor;
 
+// Placement of a game board in window pixels. Tile (0, 0) is drawn at (x, y)
+// and every unscaled pixel covers scale window pixels.
+typedef struct {
+    f32_t x;
+    f32_t y;
+    f32_t scale;
+} BoardView;
+
 int32_t render_init(void);
 void render_drop(void);
 
+BoardView render_default_board_view(void);
+
+void render_clear(void);
 void render_draw_background(void);
-void render_draw_tile(int32_t x_pos, int32_t y_pos, EColor color);
+void render_draw_tile(BoardView const* view, int32_t x_pos, int32_t y_pos,
+                      EColor color);
+// Faded tile showing where the falling brick will land
+void render_draw_ghost_tile(BoardView const* view, int32_t x_pos,
+                            int32_t y_pos, EColor color);
 void render_draw_board(void);
 
-void render_particle(f32_t x, f32_t y);
+void render_particles(BoardView const* view, f32_t const* xs,
+                      f32_t const* ys, int32_t num_particles);
+
+// Text in window pixels, every font pixel covers scale window pixels.
+void render_draw_text(f32_t x, f32_t y, f32_t scale, Pixel color,
+                      char const* text);
 
 void render_present(void);
 
@@ -0,0 +1,217 @@
+#include "sim.h"
+
+#include "log.h"
+
+#include <SDL_error.h>
+#include <SDL_thread.h>
+#include <SDL_timer.h>
+#include <stdatomic.h>
+
+#define SIM_INPUT_QUEUE_SIZE 64
+// Marks a shared snapshot slot the render thread has not picked up yet
+#define SIM_SLOT_FRESH 4
+#define SIM_SLOT_MASK 3
+
+GameState g_sim_game = {0};
+bool g_sim_is_spectating = false;
+uint64_t g_sim_tick = 0;
+uint32_t g_sim_gravity_ms = 0;
+// Worst particle time of the previous and the current peak window
+f32_t g_sim_particles_peak_ms[2] = {0};
+SDL_Thread* g_sim_thread = NULL;
+_Atomic bool g_sim_is_running = false;
+
+// Single producer, single consumer ring. Head is only written by the render
+// thread and tail only by the simulation thread.
+uint8_t g_sim_inputs[SIM_INPUT_QUEUE_SIZE] = {0};
+_Atomic uint32_t g_sim_input_head = 0;
+_Atomic uint32_t g_sim_input_tail = 0;
+
+// Triple buffer: the simulation writes one slot, the renderer reads another
+// and the third is swapped between them with a single atomic exchange.
+SimSnapshot g_sim_snapshots[3];
+int32_t g_sim_write_slot = 0;
+int32_t g_sim_read_slot = 1;
+_Atomic int32_t g_sim_shared_slot = 2;
+
+static f32_t sim_ms_since(uint64_t start) {
+    return (f32_t)(SDL_GetPerformanceCounter() - start) * 1000.f /
+           (f32_t)SDL_GetPerformanceFrequency();
+}
+
+bool sim_push_input(ESimInput input) {
+    uint32_t const head =
+        atomic_load_explicit(&g_sim_input_head, memory_order_relaxed);
+    uint32_t const tail =
+        atomic_load_explicit(&g_sim_input_tail, memory_order_acquire);
+    if (head - tail == SIM_INPUT_QUEUE_SIZE) {
+        return false;
+    }
+    g_sim_inputs[head % SIM_INPUT_QUEUE_SIZE] = (uint8_t)input;
+    atomic_store_explicit(&g_sim_input_head, head + 1, memory_order_release);
+    return true;
+}
+
+static bool sim_pop_input(ESimInput* input) {
+    uint32_t const tail =
+        atomic_load_explicit(&g_sim_input_tail, memory_order_relaxed);
+    uint32_t const head =
+        atomic_load_explicit(&g_sim_input_head, memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+    *input = (ESimInput)g_sim_inputs[tail % SIM_INPUT_QUEUE_SIZE];
+    atomic_store_explicit(&g_sim_input_tail, tail + 1, memory_order_release);
+    return true;
+}
+
+static void sim_publish(f32_t tick_ms, f32_t particles_ms) {
+    uint64_t const window = g_sim_tick / SIM_PEAK_WINDOW_TICKS;
+    f32_t* peak = &g_sim_particles_peak_ms[window & 1];
+    if (g_sim_tick % SIM_PEAK_WINDOW_TICKS == 0) {
+        *peak = 0.f;
+    }
+    *peak = particles_ms > *peak ? particles_ms : *peak;
+
+    SimSnapshot* snapshot = &g_sim_snapshots[g_sim_write_slot];
+    snapshot->tick = g_sim_tick;
+    if (g_sim_is_spectating) {
+        snapshot->num_games = spectator_num_games();
+        spectator_snapshot(snapshot->games, &snapshot->table_stats);
+    } else {
+        snapshot->num_games = 1;
+        snapshot->games[0] = g_sim_game;
+    }
+    snapshot->num_particles =
+        particles_copy_live(snapshot->particles_x, snapshot->particles_y);
+    snapshot->tick_ms = tick_ms;
+    snapshot->particles_ms = particles_ms;
+    snapshot->particles_peak_ms =
+        g_sim_particles_peak_ms[0] > g_sim_particles_peak_ms[1]
+            ? g_sim_particles_peak_ms[0]
+            : g_sim_particles_peak_ms[1];
+
+    int32_t const previous = atomic_exchange_explicit(
+        &g_sim_shared_slot, g_sim_write_slot | SIM_SLOT_FRESH,
+        memory_order_acq_rel);
+    g_sim_write_slot = previous & SIM_SLOT_MASK;
+}
+
+SimSnapshot const* sim_latest_snapshot(void) {
+    if (atomic_load_explicit(&g_sim_shared_slot, memory_order_relaxed) &
+        SIM_SLOT_FRESH) {
+        int32_t const fresh = atomic_exchange_explicit(
+            &g_sim_shared_slot, g_sim_read_slot, memory_order_acq_rel);
+        g_sim_read_slot = fresh & SIM_SLOT_MASK;
+    }
+    return &g_sim_snapshots[g_sim_read_slot];
+}
+
+static void sim_handle_input(ESimInput input, bool* with_down_force) {
+    switch (input) {
+        case ESimInput_Left: {
+            move_sideway(&g_sim_game, -1);
+        } break;
+        case ESimInput_Right: {
+            move_sideway(&g_sim_game, 1);
+        } break;
+        case ESimInput_SoftDrop: {
+            *with_down_force = true;
+            game_handle_down_movement(&g_sim_game, *with_down_force);
+        } break;
+        case ESimInput_HardDrop: {
+            game_handle_hard_drop(&g_sim_game);
+        } break;
+        case ESimInput_RotateCW: {
+            brick_rotate(&g_sim_game, ERotation_CW);
+        } break;
+        case ESimInput_RotateCCW: {
+            brick_rotate(&g_sim_game, ERotation_CCW);
+        } break;
+    }
+}
+
+static void sim_tick(void) {
+    uint64_t const tick_start = SDL_GetPerformanceCounter();
+
+    bool with_down_force = false;
+    ESimInput input = ESimInput_Left;
+    while (sim_pop_input(&input)) {
+        if (!g_sim_is_spectating) {
+            sim_handle_input(input, &with_down_force);
+        }
+    }
+
+    if (g_sim_is_spectating) {
+        spectator_update();
+    } else {
+        g_sim_gravity_ms += SIM_TICK_MS;
+        if (g_sim_gravity_ms >= SIM_GRAVITY_INTERVAL_MS) {
+            g_sim_gravity_ms -= SIM_GRAVITY_INTERVAL_MS;
+            game_handle_down_movement(&g_sim_game, with_down_force);
+        }
+        if (g_sim_game.is_over) {
+            LOG_INFO("Game over with score %i\n", g_sim_game.score);
+            game_init(&g_sim_game, g_sim_game.rng_state);
+            g_sim_game.has_effects = true;
+        }
+
+        particles_update((f32_t)SIM_TICK_MS / 1000.f);
+    }
+
+    g_sim_tick++;
+    // Includes line clear bursts emitted by touchdowns earlier in the tick
+    f32_t const particles_ms = particles_take_work_ms();
+    sim_publish(sim_ms_since(tick_start), particles_ms);
+}
+
+static int sim_main(void* data) {
+    (void)data;
+    uint32_t next_tick = SDL_GetTicks();
+    while (atomic_load_explicit(&g_sim_is_running, memory_order_acquire)) {
+        sim_tick();
+
+        // Fixed time step: ticks that fall behind run back to back
+        next_tick += SIM_TICK_MS;
+        uint32_t const now = SDL_GetTicks();
+        int32_t const ahead = (int32_t)(next_tick - now);
+        if (ahead > 0) {
+            SDL_Delay((uint32_t)ahead);
+        } else if (-ahead > SIM_MAX_LAG_MS) {
+            next_tick = now;
+        }
+    }
+    return 0;
+}
+
+int32_t sim_start(uint32_t seed, bool is_spectating) {
+    g_sim_is_spectating = is_spectating;
+    g_sim_tick = 0;
+    g_sim_gravity_ms = 0;
+    g_sim_particles_peak_ms[0] = 0.f;
+    g_sim_particles_peak_ms[1] = 0.f;
+    game_init(&g_sim_game, seed);
+    g_sim_game.has_effects = true;
+
+    // Something to draw before the first tick is done
+    sim_publish(0.f, 0.f);
+    sim_latest_snapshot();
+
+    atomic_store(&g_sim_is_running, true);
+    g_sim_thread = SDL_CreateThread(sim_main, "Simulation", NULL);
+    if (g_sim_thread == NULL) {
+        LOG_ERROR("Could not start simulation thread: %s\n", SDL_GetError());
+        atomic_store(&g_sim_is_running, false);
+        return 1;
+    }
+    return 0;
+}
+
+void sim_stop(void) {
+    if (g_sim_thread == NULL) {
+        return;
+    }
+    atomic_store(&g_sim_is_running, false);
+    SDL_WaitThread(g_sim_thread, NULL);
+    g_sim_thread = NULL;
+}
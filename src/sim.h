@@ -0,0 +1,65 @@
+#ifndef C_TRIS_SIM_H_
+#define C_TRIS_SIM_H_
+
+#include "defs.h"
+#include "game.h"
+#include "particles.h"
+#include "spectator.h"
+#include "transposition.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Simulation thread:
+The games, gravity, the bots and the particles advance at a fixed tick rate
+on their own thread, so a stalled render_present never delays them. Input is
+passed in through a lock-free queue. After every tick the simulation copies
+what is needed for drawing into a snapshot and publishes it through a
+lock-free triple buffer. The render thread always draws the newest published
+snapshot. Snapshots are preallocated, so nothing allocates during the handoff.
+The simulation thread is the only user of the job pool while it runs.
+*/
+
+#define SIM_TICK_MS 16
+#define SIM_GRAVITY_INTERVAL_MS 800
+#define SIM_PEAK_WINDOW_TICKS (1000 / SIM_TICK_MS)
+// Beyond this the simulation skips ahead instead of catching up tick by tick
+#define SIM_MAX_LAG_MS 250
+
+typedef enum {
+    ESimInput_Left,
+    ESimInput_Right,
+    ESimInput_SoftDrop,
+    ESimInput_HardDrop,
+    ESimInput_RotateCW,
+    ESimInput_RotateCCW,
+} ESimInput;
+
+typedef struct {
+    uint64_t tick;
+    // The player's game, or every spectated game
+    int32_t num_games;
+    GameState games[MAX_SPECTATED_GAMES];
+    TTStats table_stats;
+    int32_t num_particles;
+    f32_t particles_x[MAX_PARTICLES];
+    f32_t particles_y[MAX_PARTICLES];
+    f32_t tick_ms;
+    // Emitting and updating particles this tick, and the worst tick within
+    // the last one to two seconds so line clear spikes stay visible
+    f32_t particles_ms;
+    f32_t particles_peak_ms;
+} SimSnapshot;
+
+// Spectating expects spectator_init to have been called.
+int32_t sim_start(uint32_t seed, bool is_spectating);
+void sim_stop(void);
+
+// Render thread only. Returns false when the queue is full and the input was
+// dropped.
+bool sim_push_input(ESimInput input);
+// Render thread only. The snapshot is left alone by the simulation until the
+// next call.
+SimSnapshot const* sim_latest_snapshot(void);
+
+#endif
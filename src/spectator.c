@@ -0,0 +1,144 @@
+#include "spectator.h"
+
+#include "bot.h"
+#include "defs.h"
+#include "game.h"
+#include "jobs.h"
+#include "log.h"
+#include "render.h"
+#include "transposition.h"
+
+#include <stdio.h>
+
+typedef struct {
+    GameState game;
+    Bot bot;
+    BoardView view;
+} SpectatedGame;
+
+SpectatedGame g_spectated[MAX_SPECTATED_GAMES] = {0};
+int32_t g_num_spectated = 0;
+TranspositionTable g_bot_table = {0};
+
+int32_t spectator_init(int32_t cols, int32_t rows, uint32_t seed,
+                       size_t table_bytes) {
+    if (cols <= 0 || rows <= 0 || cols * rows > MAX_SPECTATED_GAMES) {
+        LOG_ERROR("Can not spectate %ix%i games\n", cols, rows);
+        return 1;
+    }
+    if (tt_init(&g_bot_table, table_bytes) != 0) {
+        return 1;
+    }
+
+    // Board including its border, in unscaled pixels
+    f32_t const board_width = (f32_t)((GAME_TILES_WIDE + 2) * TILE_SIZE);
+    f32_t const board_height = (f32_t)((GAME_TILES_HIGH + 1) * TILE_SIZE);
+    f32_t const cell_width = (f32_t)(UNSCALED_WINDOW_WIDTH * DPI) / (f32_t)cols;
+    f32_t const cell_height =
+        (f32_t)(UNSCALED_WINDOW_HEIGHT * DPI) / (f32_t)rows;
+    f32_t scale = cell_width / board_width;
+    if (cell_height / board_height < scale) {
+        scale = cell_height / board_height;
+    }
+
+    g_num_spectated = cols * rows;
+    for (int32_t i = 0; i < g_num_spectated; i++) {
+        SpectatedGame* s = &g_spectated[i];
+        game_init(&s->game, seed + (uint32_t)i * 7919);
+        bot_init(&s->bot, &g_bot_table);
+
+        f32_t const cell_x = (f32_t)(i % cols) * cell_width;
+        f32_t const cell_y = (f32_t)(i / cols) * cell_height;
+        s->view = (BoardView){
+            .x = cell_x + (cell_width - board_width * scale) / 2.f +
+                 (f32_t)TILE_SIZE * scale,
+            .y = cell_y + (cell_height - board_height * scale) / 2.f,
+            .scale = scale};
+    }
+
+    return 0;
+}
+
+static TTStats spectator_table_stats(void) {
+    TTStats total = {0};
+    for (int32_t i = 0; i < g_num_spectated; i++) {
+        tt_stats_add(&total, &g_spectated[i].bot.table_stats);
+    }
+    return total;
+}
+
+void spectator_release(void) {
+    if (g_bot_table.entries != NULL) {
+        TTStats const table_stats = spectator_table_stats();
+        LOG_INFO("Bot table hit rate %.1f%% using %zu bytes\n",
+                 (f64_t)tt_hit_rate(&table_stats) * 100.0,
+                 tt_memory_bytes(&g_bot_table));
+    }
+    tt_release(&g_bot_table);
+    g_num_spectated = 0;
+}
+
+static void spectator_step_games(void* data, int32_t begin, int32_t end) {
+    (void)data;
+    for (int32_t i = begin; i < end; i++) {
+        SpectatedGame* s = &g_spectated[i];
+        bot_step(&s->bot, &s->game);
+        if (s->game.is_over) {
+            LOG_INFO("Game %i over with score %i\n", i, s->game.score);
+            game_init(&s->game, s->game.rng_state);
+            TTStats const table_stats = s->bot.table_stats;
+            bot_init(&s->bot, &g_bot_table);
+            s->bot.table_stats = table_stats;
+        }
+    }
+}
+
+void spectator_update(void) {
+    jobs_parallel_for(g_num_spectated, 4, spectator_step_games, NULL);
+}
+
+int32_t spectator_num_games(void) { return g_num_spectated; }
+
+void spectator_snapshot(GameState games[], TTStats* table_stats) {
+    for (int32_t i = 0; i < g_num_spectated; i++) {
+        games[i] = g_spectated[i].game;
+    }
+    *table_stats = spectator_table_stats();
+}
+
+static void draw_border(BoardView const* view) {
+    for (int32_t y = 0; y < GAME_TILES_HIGH; y++) {
+        render_draw_tile(view, -1, y, EColor_Border);
+        render_draw_tile(view, GAME_TILES_WIDE, y, EColor_Border);
+    }
+    for (int32_t x = -1; x <= GAME_TILES_WIDE; x++) {
+        render_draw_tile(view, x, GAME_TILES_HIGH, EColor_Border);
+    }
+}
+
+void spectator_draw(GameState const games[], TTStats const* table_stats) {
+    render_clear();
+    for (int32_t i = 0; i < g_num_spectated; i++) {
+        SpectatedGame const* s = &g_spectated[i];
+        draw_border(&s->view);
+        game_draw(&games[i], &s->view, false);
+
+        // Too small to read on large grids
+        if (s->view.scale >= 1.f) {
+            char score[16];
+            snprintf(score, sizeof(score), "%i", games[i].score);
+            Pixel const white = {.r = 255, .g = 255, .b = 255, .a = 255};
+            render_draw_text(s->view.x + s->view.scale,
+                             s->view.y + s->view.scale, s->view.scale, white,
+                             score);
+        }
+    }
+
+    char stats[48];
+    snprintf(stats, sizeof(stats), "TT HIT %.0f%% %zuKB",
+             (f64_t)tt_hit_rate(table_stats) * 100.0,
+             tt_memory_bytes(&g_bot_table) / 1024);
+    Pixel const yellow = {.r = 255, .g = 220, .b = 0, .a = 255};
+    render_draw_text((f32_t)DPI, (f32_t)((UNSCALED_WINDOW_HEIGHT - 4) * DPI),
+                     (f32_t)DPI / 2.f, yellow, stats);
+}
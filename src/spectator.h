@@ -0,0 +1,25 @@
+#ifndef C_TRIS_SPECTATOR_H_
+#define C_TRIS_SPECTATOR_H_
+
+#include "game.h"
+#include "transposition.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Grid of independent bot games shown in one window, e.g. for tournaments
+// and bot evaluation.
+#define MAX_SPECTATED_GAMES 256
+
+// All bots share one evaluation cache of table_bytes.
+int32_t spectator_init(int32_t cols, int32_t rows, uint32_t seed,
+                       size_t table_bytes);
+void spectator_release(void);
+void spectator_update(void);
+int32_t spectator_num_games(void);
+// Copies every game and the summed table statistics of all bots, so they
+// can be drawn while the bots keep playing.
+void spectator_snapshot(GameState games[], TTStats* table_stats);
+void spectator_draw(GameState const games[], TTStats const* table_stats);
+
+#endif
@@ -0,0 +1,74 @@
+#include "transposition.h"
+
+#include "log.h"
+
+#include <SDL_stdinc.h>
+
+int32_t tt_init(TranspositionTable* table, size_t max_bytes) {
+    // Compared by division so that huge budgets can not overflow
+    size_t num_entries = 1;
+    while (num_entries <= max_bytes / (2 * sizeof(TTEntry))) {
+        num_entries *= 2;
+    }
+
+    table->entries = SDL_calloc(num_entries, sizeof(TTEntry));
+    if (table->entries == NULL) {
+        LOG_ERROR("Failed to allocate %zu table entries\n", num_entries);
+        return 1;
+    }
+    table->mask = num_entries - 1;
+    LOG_INFO("Transposition table with %zu entries (%zu bytes)\n",
+             num_entries, tt_memory_bytes(table));
+
+    return 0;
+}
+
+void tt_release(TranspositionTable* table) {
+    SDL_free(table->entries);
+    table->entries = NULL;
+    table->mask = 0;
+}
+
+bool tt_probe(TranspositionTable* table, uint64_t key, uint64_t* data,
+              TTStats* stats) {
+    TTEntry* entry = &table->entries[key & table->mask];
+    uint64_t const check =
+        atomic_load_explicit(&entry->check, memory_order_relaxed);
+    uint64_t const value =
+        atomic_load_explicit(&entry->data, memory_order_relaxed);
+
+    stats->num_probes++;
+    // An empty entry reads as key 0 with data 0
+    if ((check ^ value) != key || (check == 0 && value == 0)) {
+        return false;
+    }
+    stats->num_hits++;
+
+    *data = value;
+    return true;
+}
+
+void tt_store(TranspositionTable* table, uint64_t key, uint64_t data) {
+    TTEntry* entry = &table->entries[key & table->mask];
+    atomic_store_explicit(&entry->check, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&entry->data, data, memory_order_relaxed);
+}
+
+void tt_stats_add(TTStats* total, TTStats const* stats) {
+    total->num_probes += stats->num_probes;
+    total->num_hits += stats->num_hits;
+}
+
+f32_t tt_hit_rate(TTStats const* stats) {
+    if (stats->num_probes == 0) {
+        return 0.f;
+    }
+    return (f32_t)((f64_t)stats->num_hits / (f64_t)stats->num_probes);
+}
+
+size_t tt_memory_bytes(TranspositionTable const* table) {
+    if (table->entries == NULL) {
+        return 0;
+    }
+    return (size_t)(table->mask + 1) * sizeof(TTEntry);
+}
@@ -0,0 +1,48 @@
+#ifndef C_TRIS_TRANSPOSITION_H_
+#define C_TRIS_TRANSPOSITION_H_
+
+#include "defs.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Fixed size cache of evaluation results shared by search threads:
+Entries are written without locks. Each entry stores its data next to
+key ^ data, so a probe that races with a store on another thread sees a
+mismatching key and is treated as a miss instead of returning torn data.
+The table is direct mapped and a store always replaces what was there.
+Probe counts are kept by each caller in its own TTStats rather than in the
+table, so that probes from many threads only ever read the shared memory.
+*/
+
+typedef struct {
+    _Atomic uint64_t check;
+    _Atomic uint64_t data;
+} TTEntry;
+
+typedef struct {
+    TTEntry* entries;
+    uint64_t mask;
+} TranspositionTable;
+
+typedef struct {
+    uint64_t num_probes;
+    uint64_t num_hits;
+} TTStats;
+
+// Uses the largest power of two number of entries that fits in max_bytes.
+int32_t tt_init(TranspositionTable* table, size_t max_bytes);
+void tt_release(TranspositionTable* table);
+
+bool tt_probe(TranspositionTable* table, uint64_t key, uint64_t* data,
+              TTStats* stats);
+void tt_store(TranspositionTable* table, uint64_t key, uint64_t data);
+
+void tt_stats_add(TTStats* total, TTStats const* stats);
+// Fraction of probes that found their key, in range [0, 1].
+f32_t tt_hit_rate(TTStats const* stats);
+size_t tt_memory_bytes(TranspositionTable const* table);
+
+#endif
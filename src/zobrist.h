@@ -0,0 +1,30 @@
+#ifndef C_TRIS_ZOBRIST_H_
+#define C_TRIS_ZOBRIST_H_
+
+#include "defs.h"
+
+#include <stdint.h>
+
+/* Zobrist hashing of board occupancy:
+Every tile position has a random 64 bit key, and a board hashes to the XOR
+of the keys of its occupied tiles.
+Setting or clearing a single tile therefore updates the hash with one XOR.
+Keys are derived from their index with SplitMix64 so there is no table to
+initialize and they are the same in every process, which keeps hashes stable
+between analysis runs.
+*/
+
+#define ZOBRIST_TILES_SEED UINT64_C(0x5ca1ab1e00000000)
+
+static inline uint64_t zobrist_mix(uint64_t x) {
+    x += UINT64_C(0x9e3779b97f4a7c15);
+    x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return x ^ (x >> 31);
+}
+
+static inline uint64_t zobrist_tile(int32_t index) {
+    return zobrist_mix(ZOBRIST_TILES_SEED + (uint64_t)index);
+}
+
+#endif